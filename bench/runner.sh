@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+TEETON=${TEETON:-../build/teeton}
+RUNS=${RUNS:-3}
+
+# arguments are passed to teeton, e.g. ./runner.sh --engine=vm
+echo "Running Teeton benchmarks ($TEETON $@, best of $RUNS)"
+
+for f in $(ls ttn); do
+    file=${f%%.*}
+    best=""
+    for run in $(seq $RUNS); do
+        start=$(date +%s%N)
+        if [ -f in/$file.in ]; then
+            $TEETON "$@" ttn/$file.ttn < in/$file.in > /dev/null
+        else
+            $TEETON "$@" ttn/$file.ttn > /dev/null
+        fi
+        elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+        if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+            best=$elapsed
+        fi
+    done
+    printf "%-24s %6d ms\n" $file $best
+done
@@ -0,0 +1,870 @@
+#include <ctype.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teeton.h"
+
+/*
+ * Lists are ported from ListStorage and TypeList of src/type.cpp. A storage is shared by lists and
+ * copied on first write, a list at the end of its storage appends in place. Lists of chars and lists
+ * of ints stay packed until a value of another type is stored into them.
+ */
+
+enum {
+    TT_GENERIC_LIST, TT_STRING_LIST, TT_INT_LIST
+};
+
+enum {
+    TT_CHAR, TT_BOOL, TT_INT, TT_LIST
+};
+
+typedef struct tt_storage {
+    int kind;
+    unsigned size;
+    size_t capacity;  /* in bytes */
+    char *data;  /* tt_value, char or int32_t elements by kind */
+    uint32_t *identities;  /* of packed elements, compared by === */
+    unsigned references;
+} tt_storage;
+
+typedef struct tt_list {
+    tt_storage *storage;
+    unsigned length;
+    char constant;
+    char marked;
+    struct tt_list *next;
+} tt_list;
+
+unsigned tt_identity = 1;
+uint64_t tt_allocated = 0;
+uint64_t tt_trigger = 0;
+
+static const uint64_t InitialHeap = 1024 * 1024;
+static const uint64_t MaxHeap = 1024 * 1024 * 1024;  /* the default --heap-max of the interpreter */
+
+static tt_value *variables;
+static char *defined;
+static unsigned variableCount;
+static const char **names;
+
+static tt_list *heap;
+static tt_list **markStack;
+static size_t markTop;
+static size_t markCapacity;
+
+static int inputFailed;
+
+/* -- Errors ---------------------------------------------------------------- */
+
+void tt_error(const char *message) {
+    printf("RuntimeError: %s\n", message);
+    exit(0);
+}
+
+tt_value tt_undefined(unsigned slot) {
+    printf("RuntimeError: Undefined variable %s.\n", names[slot]);
+    exit(0);
+    return TT_NULL;
+}
+
+/* the interpreter does not catch these, they end the same way as its uncaught exceptions */
+static void terminate(const char *exception, const char *what) {
+    fflush(stdout);
+    fprintf(stderr, "terminate called after throwing an instance of '%s'\n  what():  %s\n", exception, what);
+    abort();
+}
+
+void tt_break_outside(void) {
+    terminate("NodeBreak::BreakException", "std::exception");
+}
+
+static void divisionTrap(void) {
+    fflush(stdout);
+    raise(SIGFPE);
+    abort();
+}
+
+/* collections only run at safepoints, so the limit is checked by every allocation */
+static void checkHeap(size_t bytes) {
+    if (tt_allocated + bytes > MaxHeap) {
+        tt_error("Out of memory");
+    }
+}
+
+static void *allocate(size_t bytes) {
+    checkHeap(bytes);
+    void *memory = malloc(bytes > 0 ? bytes : 1);
+    if (memory == NULL) {
+        tt_error("Out of memory");
+    }
+    return memory;
+}
+
+/* -- Values ---------------------------------------------------------------- */
+
+static int type(tt_value value) {
+    switch (tt_tag(value)) {
+        case TT_TAG_INT:
+            return TT_INT;
+        case TT_TAG_BOOL:
+            return TT_BOOL;
+        case TT_TAG_CHAR:
+            return TT_CHAR;
+        default:
+            return TT_LIST;
+    }
+}
+
+static tt_list *listValue(tt_value value) {
+    return (tt_list *) (uintptr_t) value;
+}
+
+static tt_value fromList(tt_list *list) {
+    return (tt_value) (uintptr_t) list;
+}
+
+static int isList(tt_value value) {
+    return value != TT_NULL && tt_tag(value) == 0;
+}
+
+static char charValue(tt_value value) {
+    return (char) (value >> 32);
+}
+
+static uint32_t identity(tt_value value) {
+    return (uint32_t) ((value >> 3) & 0x1fffffff);
+}
+
+/* elements of packed lists keep their identities in a parallel buffer like in ListStorage */
+static tt_value packedChar(char value, uint32_t identity) {
+    return ((uint64_t) (unsigned char) value << 32) | ((uint64_t) identity << 3) | TT_TAG_CHAR;
+}
+
+static tt_value packedInt(int32_t value, uint32_t identity) {
+    return ((uint64_t) (uint32_t) value << 32) | ((uint64_t) identity << 3) | TT_TAG_INT;
+}
+
+/* -- Storage --------------------------------------------------------------- */
+
+static size_t elementSize(int kind) {
+    switch (kind) {
+        case TT_STRING_LIST:
+            return 1;
+        case TT_INT_LIST:
+            return sizeof(int32_t);
+        default:
+            return sizeof(tt_value);
+    }
+}
+
+static tt_storage *newStorage(int kind) {
+    tt_storage *storage = allocate(sizeof(tt_storage));
+    storage->kind = kind;
+    storage->size = 0;
+    storage->capacity = 0;
+    storage->data = NULL;
+    storage->identities = NULL;
+    storage->references = 1;
+    tt_allocated += sizeof(tt_storage);
+    return storage;
+}
+
+static size_t storageBytes(tt_storage *storage) {
+    size_t bytes = sizeof(tt_storage) + storage->capacity;
+    if (storage->kind != TT_GENERIC_LIST) {
+        bytes += storage->capacity / elementSize(storage->kind) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+static void freeStorage(tt_storage *storage) {
+    tt_allocated -= storageBytes(storage);
+    free(storage->data);
+    free(storage->identities);
+    free(storage);
+}
+
+static void reserve(tt_storage *storage, size_t count) {
+    size_t size = elementSize(storage->kind);
+    size_t bytes = count * size;
+    if (bytes <= storage->capacity) {
+        return;
+    }
+
+    size_t before = storageBytes(storage);
+    size_t capacity = storage->capacity * 2 > bytes ? storage->capacity * 2 : bytes;
+    checkHeap((capacity - storage->capacity) / size * (size + sizeof(uint32_t)));
+    char *data = realloc(storage->data, capacity);
+    if (data == NULL) {
+        tt_error("Out of memory");
+    }
+    storage->data = data;
+    if (storage->kind != TT_GENERIC_LIST) {
+        uint32_t *identities = realloc(storage->identities, capacity / size * sizeof(uint32_t));
+        if (identities == NULL) {
+            tt_error("Out of memory");
+        }
+        storage->identities = identities;
+    }
+    storage->capacity = capacity;
+    tt_allocated += storageBytes(storage) - before;
+}
+
+/* an empty storage takes the kind of its first element */
+static void convert(tt_storage *storage, int kind) {
+    if (storage->kind == kind) {
+        return;
+    }
+
+    tt_allocated -= storageBytes(storage);
+    free(storage->data);
+    free(storage->identities);
+    storage->data = NULL;
+    storage->identities = NULL;
+    storage->capacity = 0;
+    storage->kind = kind;
+    tt_allocated += storageBytes(storage);
+}
+
+static tt_value storageGet(tt_storage *storage, unsigned index) {
+    switch (storage->kind) {
+        case TT_STRING_LIST:
+            return packedChar(storage->data[index], storage->identities[index]);
+        case TT_INT_LIST:
+            return packedInt(((int32_t *) storage->data)[index], storage->identities[index]);
+        default:
+            return ((tt_value *) storage->data)[index];
+    }
+}
+
+static int kindOf(tt_value value) {
+    switch (type(value)) {
+        case TT_CHAR:
+            return TT_STRING_LIST;
+        case TT_INT:
+            return TT_INT_LIST;
+        default:
+            return TT_GENERIC_LIST;
+    }
+}
+
+static void generalize(tt_storage *storage) {
+    if (storage->kind == TT_GENERIC_LIST) {
+        return;
+    }
+
+    tt_value *items = allocate(storage->size * sizeof(tt_value));
+    for (unsigned i = 0; i < storage->size; i++) {
+        items[i] = storageGet(storage, i);
+    }
+    tt_allocated -= storageBytes(storage);
+    free(storage->data);
+    free(storage->identities);
+    storage->kind = TT_GENERIC_LIST;
+    storage->data = (char *) items;
+    storage->identities = NULL;
+    storage->capacity = storage->size * sizeof(tt_value);
+    tt_allocated += storageBytes(storage);
+}
+
+static void storageSet(tt_storage *storage, unsigned index, tt_value value) {
+    if (storage->kind == TT_STRING_LIST && type(value) == TT_CHAR) {
+        storage->data[index] = charValue(value);
+        storage->identities[index] = identity(value);
+    } else if (storage->kind == TT_INT_LIST && type(value) == TT_INT) {
+        ((int32_t *) storage->data)[index] = tt_int_value(value);
+        storage->identities[index] = identity(value);
+    } else {
+        generalize(storage);
+        ((tt_value *) storage->data)[index] = value;
+    }
+}
+
+static void storageAppend(tt_storage *storage, tt_value value) {
+    if (storage->size == 0) {
+        convert(storage, kindOf(value));
+    }
+
+    if (!(storage->kind == TT_STRING_LIST && type(value) == TT_CHAR) &&
+        !(storage->kind == TT_INT_LIST && type(value) == TT_INT)) {
+        generalize(storage);
+    }
+
+    reserve(storage, storage->size + 1);
+    switch (storage->kind) {
+        case TT_STRING_LIST:
+            storage->data[storage->size] = charValue(value);
+            storage->identities[storage->size] = identity(value);
+            break;
+        case TT_INT_LIST:
+            ((int32_t *) storage->data)[storage->size] = tt_int_value(value);
+            storage->identities[storage->size] = identity(value);
+            break;
+        default:
+            ((tt_value *) storage->data)[storage->size] = value;
+    }
+    storage->size++;
+}
+
+static void appendAll(tt_storage *storage, tt_storage *other, unsigned length) {
+    if (storage->size == 0) {
+        convert(storage, other->kind);
+    }
+
+    if (storage->kind == other->kind && storage->kind != TT_GENERIC_LIST) {
+        size_t size = elementSize(storage->kind);
+        reserve(storage, storage->size + length);
+        if (length > 0) {
+            memcpy(storage->data + storage->size * size, other->data, length * size);
+            memcpy(storage->identities + storage->size, other->identities, length * sizeof(uint32_t));
+        }
+        storage->size += length;
+        return;
+    }
+
+    generalize(storage);
+    reserve(storage, storage->size + length);
+    for (unsigned i = 0; i < length; i++) {
+        ((tt_value *) storage->data)[storage->size++] = storageGet(other, i);
+    }
+}
+
+static tt_storage *copy(tt_storage *storage, unsigned length) {
+    tt_storage *result = newStorage(storage->kind);
+    appendAll(result, storage, length);
+    return result;
+}
+
+/* -- Lists ----------------------------------------------------------------- */
+
+static tt_list *newList(tt_storage *storage, unsigned length, int constant) {
+    tt_list *list = allocate(sizeof(tt_list));
+    list->storage = storage;
+    list->length = length;
+    list->constant = (char) constant;
+    list->marked = 0;
+    list->next = NULL;
+    if (!constant) {
+        list->next = heap;
+        heap = list;
+        tt_allocated += sizeof(tt_list);
+    }
+    return list;
+}
+
+static tt_storage *share(tt_list *list) {
+    list->storage->references++;
+    return list->storage;
+}
+
+static int isTip(tt_list *list) {
+    return list->length == list->storage->size;
+}
+
+static void detach(tt_list *list) {
+    if (list->storage->references > 1) {
+        list->storage->references--;
+        list->storage = copy(list->storage, list->length);
+    } else if (!isTip(list)) {
+        list->storage->size = list->length;
+    }
+}
+
+static tt_value listGet(tt_list *list, unsigned index) {
+    if (index >= list->length) {
+        terminate("std::out_of_range", "list index out of range");
+    }
+    return storageGet(list->storage, index);
+}
+
+tt_value tt_string(const char *chars, unsigned length) {
+    tt_storage *storage = newStorage(TT_STRING_LIST);
+    reserve(storage, length);
+    if (length > 0) {
+        memcpy(storage->data, chars, length);
+    }
+    for (unsigned i = 0; i < length; i++) {
+        storage->identities[i] = tt_next_identity();
+    }
+    storage->size = length;
+    storage->references++;  /* held by the constant pool */
+    return fromList(newList(storage, length, 1));
+}
+
+tt_value tt_share(tt_value constant) {
+    tt_list *list = listValue(constant);
+    return fromList(newList(share(list), list->length, 1));
+}
+
+tt_value tt_materialize(tt_value value) {
+    if (isList(value) && listValue(value)->constant) {
+        tt_list *constant = listValue(value);
+        return fromList(newList(share(constant), constant->length, 0));
+    }
+    return value;
+}
+
+/* -- Comparison ------------------------------------------------------------ */
+
+static int equals(tt_list *a, tt_list *b);
+
+static int compare(tt_list *a, tt_list *b);
+
+static int equalValues(tt_value a, tt_value b) {
+    if (type(a) != type(b)) {
+        return 0;
+    }
+
+    if (type(a) == TT_LIST) {
+        return equals(listValue(a), listValue(b));
+    }
+    return (a >> 32) == (b >> 32);
+}
+
+static int compareValues(tt_value a, tt_value b) {
+    if (type(a) != type(b)) {
+        tt_error("Cannot apply operator for different types.");
+    }
+
+    switch (type(a)) {
+        case TT_CHAR:
+            return charValue(a) < charValue(b) ? -1 : (charValue(a) > charValue(b) ? 1 : 0);
+        case TT_INT:
+            return tt_int_value(a) < tt_int_value(b) ? -1 : (tt_int_value(a) > tt_int_value(b) ? 1 : 0);
+        case TT_LIST:
+            return compare(listValue(a), listValue(b));
+        default:
+            tt_error("Operator not suported for type");
+            return 0;
+    }
+}
+
+static int packed(tt_list *a, tt_list *b) {
+    return a->storage->kind == b->storage->kind && a->storage->kind != TT_GENERIC_LIST;
+}
+
+static int equals(tt_list *a, tt_list *b) {
+    if (a->length != b->length) {
+        return 0;
+    }
+
+    if (packed(a, b) && a->length > 0) {
+        return memcmp(a->storage->data, b->storage->data, a->length * elementSize(a->storage->kind)) == 0;
+    }
+
+    for (unsigned i = 0; i < a->length; i++) {
+        if (!equalValues(storageGet(a->storage, i), storageGet(b->storage, i))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare(tt_list *a, tt_list *b) {
+    unsigned common = a->length < b->length ? a->length : b->length;
+    unsigned i = 0;
+
+    if (packed(a, b)) {
+        while (i < common && storageGet(a->storage, i) >> 32 == storageGet(b->storage, i) >> 32) {
+            i++;
+        }
+    } else {
+        for (; i < common; i++) {
+            int result = compareValues(storageGet(a->storage, i), storageGet(b->storage, i));
+            if (result != 0) {
+                return result;
+            }
+        }
+    }
+
+    if (i < common) {
+        return compareValues(storageGet(a->storage, i), storageGet(b->storage, i));
+    }
+    return a->length < b->length ? -1 : (a->length > b->length ? 1 : 0);
+}
+
+/* -- Operators ------------------------------------------------------------- */
+
+static int supportsOperator(tt_value value, int op) {
+    if (op == TT_EQEQ) {
+        return 1;
+    }
+
+    switch (type(value)) {
+        case TT_BOOL:
+            return op == TT_EQ || op == TT_NEQ || op == TT_AND || op == TT_OR;
+        case TT_CHAR:
+            return op == TT_EQ || op == TT_NEQ || op == TT_GT || op == TT_LT || op == TT_GTE || op == TT_LTE;
+        case TT_INT:
+            return op != TT_AND && op != TT_OR;
+        default:
+            return op != TT_SUB && op != TT_MUL && op != TT_DIV && op != TT_MOD && op != TT_AND && op != TT_OR;
+    }
+}
+
+static tt_value concat(tt_list *a, tt_list *b) {
+    if (isTip(a) && a->storage != b->storage) {
+        appendAll(a->storage, b->storage, b->length);
+        return fromList(newList(share(a), a->length + b->length, 0));
+    }
+    tt_storage *storage = copy(a->storage, a->length);
+    appendAll(storage, b->storage, b->length);
+    return fromList(newList(storage, storage->size, 0));
+}
+
+static tt_value applyInt(int op, int32_t a, int32_t b) {
+    switch (op) {
+        case TT_ADD:
+            return tt_make_int((int32_t) ((uint32_t) a + (uint32_t) b));
+        case TT_SUB:
+            return tt_make_int((int32_t) ((uint32_t) a - (uint32_t) b));
+        case TT_MUL:
+            return tt_make_int((int32_t) ((uint32_t) a * (uint32_t) b));
+        case TT_DIV:
+        case TT_MOD:
+            if (b == 0 || (b == -1 && a == INT32_MIN)) {
+                divisionTrap();
+            }
+            if (b == -1) {
+                return tt_make_int(op == TT_DIV ? -a : 0);
+            }
+            return tt_make_int(op == TT_DIV ? a / b : a % b);
+        case TT_EQ:
+            return tt_make_bool(a == b);
+        case TT_NEQ:
+            return tt_make_bool(a != b);
+        case TT_GT:
+            return tt_make_bool(a > b);
+        case TT_LT:
+            return tt_make_bool(a < b);
+        case TT_GTE:
+            return tt_make_bool(a >= b);
+        default:
+            return tt_make_bool(a <= b);
+    }
+}
+
+tt_value tt_binary(int op, tt_value a, tt_value b) {
+    if (type(a) != type(b)) {
+        tt_error("Cannot apply operator for different types.");
+    }
+
+    if (!supportsOperator(a, op)) {
+        tt_error("Operator not supported by type.");
+    }
+
+    if (op == TT_EQEQ) {
+        return tt_make_bool(a == b);
+    }
+
+    switch (type(a)) {
+        case TT_BOOL: {
+            int x = (a >> 32) != 0;
+            int y = (b >> 32) != 0;
+            switch (op) {
+                case TT_EQ:
+                    return tt_make_bool(x == y);
+                case TT_NEQ:
+                    return tt_make_bool(x != y);
+                case TT_AND:
+                    return tt_make_bool(x && y);
+                default:
+                    return tt_make_bool(x || y);
+            }
+        }
+        case TT_CHAR:
+            return applyInt(op, charValue(a), charValue(b));
+        case TT_INT:
+            return applyInt(op, tt_int_value(a), tt_int_value(b));
+        default:
+            break;
+    }
+
+    tt_list *x = listValue(a);
+    tt_list *y = listValue(b);
+    switch (op) {
+        case TT_ADD:
+            return concat(x, y);
+        case TT_EQ:
+            return tt_make_bool(equals(x, y));
+        case TT_NEQ:
+            return tt_make_bool(!equals(x, y));
+        case TT_GT:
+            return tt_make_bool(compare(x, y) > 0);
+        case TT_LT:
+            return tt_make_bool(compare(x, y) < 0);
+        case TT_GTE:
+            return tt_make_bool(compare(x, y) >= 0);
+        default:
+            return tt_make_bool(compare(x, y) <= 0);
+    }
+}
+
+tt_value tt_not(tt_value value) {
+    if (type(value) != TT_BOOL) {
+        tt_error("Using not operator with non-boolean variable.");
+    }
+    return tt_make_bool((value >> 32) == 0);
+}
+
+/* -- List builtins --------------------------------------------------------- */
+
+tt_value tt_len(tt_value list) {
+    if (type(list) != TT_LIST) {
+        tt_error("len can be only used with lists.");
+    }
+    return tt_make_int((int32_t) listValue(list)->length);
+}
+
+tt_value tt_append(tt_value list, tt_value value) {
+    if (type(list) != TT_LIST) {
+        tt_error("First argument of append must be list.");
+    }
+
+    tt_list *target = listValue(tt_materialize(list));
+    value = tt_materialize(value);
+    if (!isTip(target)) {
+        detach(target);
+    }
+    storageAppend(target->storage, value);
+    target->length++;
+    return TT_NULL;
+}
+
+tt_value tt_get(tt_value list, tt_value index) {
+    if (type(list) != TT_LIST) {
+        tt_error("First argument of append must be list.");
+    }
+
+    if (type(index) != TT_INT) {
+        tt_error("Second argument of get must be int.");
+    }
+    return listGet(listValue(list), (unsigned) tt_int_value(index));
+}
+
+tt_value tt_set(tt_value list, tt_value index, tt_value value) {
+    if (type(list) != TT_LIST) {
+        tt_error("First argument of set must be list.");
+    }
+
+    if (type(index) != TT_INT) {
+        tt_error("Second argument of set must be int.");
+    }
+
+    tt_list *target = listValue(tt_materialize(list));
+    value = tt_materialize(value);
+    if ((unsigned) tt_int_value(index) >= target->length) {
+        terminate("std::out_of_range", "list index out of range");
+    }
+    detach(target);
+    storageSet(target->storage, (unsigned) tt_int_value(index), value);
+    return TT_NULL;
+}
+
+/* -- Garbage collector ----------------------------------------------------- */
+
+/*
+ * Collections only run at safepoints before statements, where no temporaries are live, so the
+ * variables are the only roots and the collector does not move anything.
+ */
+
+static void shade(tt_value value) {
+    if (!isList(value)) {
+        return;
+    }
+
+    tt_list *list = listValue(value);
+    if (list->constant || list->marked) {
+        return;
+    }
+
+    list->marked = 1;
+    if (markTop == markCapacity) {
+        markCapacity = markCapacity ? markCapacity * 2 : 256;
+        markStack = realloc(markStack, markCapacity * sizeof(tt_list *));
+        if (markStack == NULL) {
+            tt_error("Out of memory");
+        }
+    }
+    markStack[markTop++] = list;
+}
+
+void tt_collect(void) {
+    for (unsigned i = 0; i < variableCount; i++) {
+        if (defined[i]) {
+            shade(variables[i]);
+        }
+    }
+
+    while (markTop > 0) {
+        tt_list *list = markStack[--markTop];
+        if (list->storage->kind == TT_GENERIC_LIST) {
+            tt_value *items = (tt_value *) list->storage->data;
+            for (unsigned i = 0; i < list->length; i++) {
+                shade(items[i]);
+            }
+        }
+    }
+
+    tt_list **link = &heap;
+    while (*link != NULL) {
+        tt_list *list = *link;
+        if (list->marked) {
+            list->marked = 0;
+            link = &list->next;
+            continue;
+        }
+
+        *link = list->next;
+        if (--list->storage->references == 0) {
+            freeStorage(list->storage);
+        }
+        tt_allocated -= sizeof(tt_list);
+        free(list);
+    }
+
+    tt_trigger = tt_allocated * 2 > InitialHeap ? tt_allocated * 2 : InitialHeap;
+    if (tt_trigger > MaxHeap) {
+        tt_trigger = MaxHeap;
+    }
+}
+
+/* -- Input and output ------------------------------------------------------ */
+
+static void printValue(tt_value value);
+
+static void printList(tt_list *list) {
+    if (list->storage->kind == TT_STRING_LIST && list->length > 0) {
+        fwrite(list->storage->data, 1, list->length, stdout);
+        return;
+    }
+
+    if (list->length > 0 && type(listGet(list, 0)) == TT_CHAR) {
+        for (unsigned i = 0; i < list->length; i++) {
+            printValue(listGet(list, i));
+        }
+        return;
+    }
+
+    putchar('[');
+    for (unsigned i = 0; i < list->length; i++) {
+        if (i > 0) {
+            fputs(", ", stdout);
+        }
+        printValue(listGet(list, i));
+    }
+    putchar(']');
+}
+
+static void printValue(tt_value value) {
+    switch (type(value)) {
+        case TT_BOOL:
+            fputs((value >> 32) ? "True" : "False", stdout);
+            break;
+        case TT_CHAR:
+            putchar(charValue(value));
+            break;
+        case TT_INT:
+            printf("%d", tt_int_value(value));
+            break;
+        default:
+            printList(listValue(value));
+    }
+}
+
+tt_value tt_print(tt_value value) {
+    printValue(value);
+    return TT_NULL;
+}
+
+tt_value tt_println(tt_value value) {
+    printValue(value);
+    putchar('\n');
+    return TT_NULL;
+}
+
+/* Input is read like with std::cin, leading whitespace is skipped and a failed read fails all later ones. */
+
+static int skipWhitespace(void) {
+    int c = getchar();
+    while (c != EOF && isspace(c)) {
+        c = getchar();
+    }
+    return c;
+}
+
+tt_value tt_scan_int(void) {
+    int c = inputFailed ? EOF : skipWhitespace();
+    int negative = 0;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        c = getchar();
+    }
+
+    if (c == EOF || !isdigit(c)) {
+        inputFailed = 1;
+        return tt_make_int(0);
+    }
+
+    long long number = 0;
+    while (c != EOF && isdigit(c)) {
+        if (number <= (long long) INT32_MAX + 1) {
+            number = number * 10 + (c - '0');
+        }
+        c = getchar();
+    }
+    ungetc(c, stdin);
+
+    if (negative) {
+        number = -number;
+    }
+    if (number > INT32_MAX || number < INT32_MIN) {
+        inputFailed = 1;
+        return tt_make_int(number > 0 ? INT32_MAX : INT32_MIN);
+    }
+    return tt_make_int((int32_t) number);
+}
+
+tt_value tt_scan_char(void) {
+    int c = inputFailed ? EOF : skipWhitespace();
+    if (c == EOF) {
+        inputFailed = 1;
+        return tt_make_char(0);
+    }
+    return tt_make_char((char) c);
+}
+
+tt_value tt_scan_string(void) {
+    tt_storage *storage = newStorage(TT_STRING_LIST);
+    int c = inputFailed ? EOF : skipWhitespace();
+    if (c == EOF) {
+        inputFailed = 1;
+    }
+
+    while (c != EOF && !isspace(c)) {
+        reserve(storage, storage->size + 1);
+        storage->identities[storage->size] = tt_next_identity();
+        storage->data[storage->size++] = (char) c;
+        c = getchar();
+    }
+    ungetc(c, stdin);
+    return fromList(newList(storage, storage->size, 0));
+}
+
+/* -- Program --------------------------------------------------------------- */
+
+void tt_init(tt_value *values, char *definedValues, unsigned count, const char **variableNames) {
+    variables = values;
+    defined = definedValues;
+    variableCount = count;
+    names = variableNames;
+    tt_trigger = InitialHeap;
+}
+
+int tt_exit(void) {
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#ifndef TEETON_RUNTIME_H
+#define TEETON_RUNTIME_H
+
+/*
+ * Runtime of programs compiled to C by teeton --emit-c. Values have the layout of Value in
+ * src/type.h: bits 0-2 tag, bits 3-31 identity, bits 32-63 payload, lists are pointers.
+ */
+
+#include <stdint.h>
+
+typedef uint64_t tt_value;
+
+#define TT_NULL ((tt_value) 0)
+
+#define TT_TAG_MASK 0x7
+#define TT_TAG_INT 1
+#define TT_TAG_BOOL 2
+#define TT_TAG_CHAR 3
+
+/* in the order of Operator in src/enums.h */
+enum {
+    TT_ADD, TT_SUB, TT_MUL, TT_DIV, TT_MOD, TT_EQ, TT_NEQ, TT_EQEQ, TT_GT, TT_LT, TT_GTE, TT_LTE, TT_AND, TT_OR
+};
+
+extern unsigned tt_identity;
+extern uint64_t tt_allocated;
+extern uint64_t tt_trigger;
+
+void tt_init(tt_value *variables, char *defined, unsigned count, const char **names);
+
+int tt_exit(void);
+
+void tt_collect(void);
+
+/* statements start at a safepoint, the variables are the only roots there */
+#define TT_SAFEPOINT() do { if (tt_allocated >= tt_trigger) tt_collect(); } while (0)
+
+void tt_error(const char *message);
+
+tt_value tt_undefined(unsigned slot);
+
+void tt_break_outside(void);
+
+/* -- Values ---------------------------------------------------------------- */
+
+static inline unsigned tt_tag(tt_value value) { return (unsigned) (value & TT_TAG_MASK); }
+
+static inline int32_t tt_int_value(tt_value value) { return (int32_t) (value >> 32); }
+
+/* identities are never reused, the program fails once they run out */
+static inline unsigned tt_next_identity(void) {
+    if (tt_identity > 0x0fffffff) {
+        tt_error("Out of identities");
+    }
+    return tt_identity++;
+}
+
+static inline tt_value tt_scalar(unsigned tag, uint32_t payload) {
+    unsigned identity = tt_next_identity();
+    return ((uint64_t) payload << 32) | ((uint64_t) identity << 3) | tag;
+}
+
+static inline tt_value tt_make_int(int32_t value) { return tt_scalar(TT_TAG_INT, (uint32_t) value); }
+
+static inline tt_value tt_make_bool(int value) { return tt_scalar(TT_TAG_BOOL, value ? 1 : 0); }
+
+static inline tt_value tt_make_char(char value) { return tt_scalar(TT_TAG_CHAR, (unsigned char) value); }
+
+/* -- Operators ------------------------------------------------------------- */
+
+tt_value tt_binary(int op, tt_value a, tt_value b);
+
+/* ints and bools are handled inline, everything else by tt_binary */
+#define TT_OPERATOR(name, op, tag, result) \
+    static inline tt_value name(tt_value a, tt_value b) { \
+        if (tt_tag(a) == tag && tt_tag(b) == tag) { \
+            int32_t x = tt_int_value(a); \
+            int32_t y = tt_int_value(b); \
+            return result; \
+        } \
+        return tt_binary(op, a, b); \
+    }
+
+TT_OPERATOR(tt_add, TT_ADD, TT_TAG_INT, tt_make_int((int32_t) ((uint32_t) x + (uint32_t) y)))
+TT_OPERATOR(tt_sub, TT_SUB, TT_TAG_INT, tt_make_int((int32_t) ((uint32_t) x - (uint32_t) y)))
+TT_OPERATOR(tt_mul, TT_MUL, TT_TAG_INT, tt_make_int((int32_t) ((uint32_t) x * (uint32_t) y)))
+TT_OPERATOR(tt_eq, TT_EQ, TT_TAG_INT, tt_make_bool(x == y))
+TT_OPERATOR(tt_neq, TT_NEQ, TT_TAG_INT, tt_make_bool(x != y))
+TT_OPERATOR(tt_gt, TT_GT, TT_TAG_INT, tt_make_bool(x > y))
+TT_OPERATOR(tt_lt, TT_LT, TT_TAG_INT, tt_make_bool(x < y))
+TT_OPERATOR(tt_gte, TT_GTE, TT_TAG_INT, tt_make_bool(x >= y))
+TT_OPERATOR(tt_lte, TT_LTE, TT_TAG_INT, tt_make_bool(x <= y))
+TT_OPERATOR(tt_and, TT_AND, TT_TAG_BOOL, tt_make_bool(x && y))
+TT_OPERATOR(tt_or, TT_OR, TT_TAG_BOOL, tt_make_bool(x || y))
+
+/* division traps on a zero divisor like the interpreter, tt_binary flushes the output first */
+TT_OPERATOR(tt_div, TT_DIV, TT_TAG_INT, y != 0 && y != -1 ? tt_make_int(x / y) : tt_binary(TT_DIV, a, b))
+TT_OPERATOR(tt_mod, TT_MOD, TT_TAG_INT, y != 0 && y != -1 ? tt_make_int(x % y) : tt_binary(TT_MOD, a, b))
+
+static inline tt_value tt_eqeq(tt_value a, tt_value b) { return tt_binary(TT_EQEQ, a, b); }
+
+tt_value tt_not(tt_value value);
+
+static inline int tt_condition(tt_value value) {
+    if (tt_tag(value) != TT_TAG_BOOL) {
+        tt_error("Cannot use non-bool value for condition.");
+    }
+    return (value >> 32) != 0;
+}
+
+/* -- Lists ----------------------------------------------------------------- */
+
+/* constant lists of literals are copied into the heap when they are stored */
+tt_value tt_string(const char *chars, unsigned length);
+
+/* another constant list of the same literal, it shares the storage like the constant pool does */
+tt_value tt_share(tt_value constant);
+
+tt_value tt_materialize(tt_value value);
+
+tt_value tt_len(tt_value list);
+
+tt_value tt_append(tt_value list, tt_value value);
+
+tt_value tt_get(tt_value list, tt_value index);
+
+tt_value tt_set(tt_value list, tt_value index, tt_value value);
+
+/* -- Input and output ------------------------------------------------------ */
+
+tt_value tt_print(tt_value value);
+
+tt_value tt_println(tt_value value);
+
+tt_value tt_scan_int(void);
+
+tt_value tt_scan_char(void);
+
+tt_value tt_scan_string(void);
+
+#endif
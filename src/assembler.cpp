@@ -0,0 +1,201 @@
+#include "assembler.h"
+
+using namespace std;
+
+unsigned Assembler::label() {
+    labels.push_back(-1);
+    return (unsigned) labels.size() - 1;
+}
+
+void Assembler::bind(unsigned label) {
+    labels[label] = (int) bytes.size();
+}
+
+vector<uint8_t> Assembler::finish() {
+    for (auto const &fixup : fixups) {
+        uint32_t offset = (uint32_t) (labels[fixup.second] - (int) (fixup.first + 4));
+        for (int i = 0; i < 4; i++) {
+            bytes[fixup.first + i] = (uint8_t) (offset >> (8 * i));
+        }
+    }
+    return bytes;
+}
+
+void Assembler::dword(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        byte((uint8_t) (value >> (8 * i)));
+    }
+}
+
+void Assembler::rex(bool wide, int reg, int rm) {
+    uint8_t prefix = (uint8_t) (0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0));
+    if (prefix != 0x40) {
+        byte(prefix);
+    }
+}
+
+void Assembler::direct(int reg, int rm) {
+    byte((uint8_t) (0xc0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+// [base + disp32], RSP and R12 as a base need a SIB byte
+void Assembler::memory(int reg, Register base, int32_t disp) {
+    byte((uint8_t) (0x80 | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == RSP) {
+        byte(0x24);
+    }
+    dword((uint32_t) disp);
+}
+
+// -----------------------------------------------------------------------------
+
+void Assembler::mov(Register dst, Register src) {
+    rex(true, src, dst);
+    byte(0x89);
+    direct(src, dst);
+}
+
+void Assembler::mov32(Register dst, Register src) {
+    rex(false, src, dst);
+    byte(0x89);
+    direct(src, dst);
+}
+
+void Assembler::load(Register dst, Register base, int32_t disp) {
+    rex(true, dst, base);
+    byte(0x8b);
+    memory(dst, base, disp);
+}
+
+void Assembler::load32(Register dst, Register base, int32_t disp) {
+    rex(false, dst, base);
+    byte(0x8b);
+    memory(dst, base, disp);
+}
+
+void Assembler::loadByte(Register dst, Register base, int32_t disp) {
+    rex(false, dst, base);
+    byte(0x0f);
+    byte(0xb6);
+    memory(dst, base, disp);
+}
+
+void Assembler::store(Register base, int32_t disp, Register src) {
+    rex(true, src, base);
+    byte(0x89);
+    memory(src, base, disp);
+}
+
+void Assembler::store32(Register base, int32_t disp, Register src) {
+    rex(false, src, base);
+    byte(0x89);
+    memory(src, base, disp);
+}
+
+void Assembler::storeByte(Register base, int32_t disp, uint8_t value) {
+    rex(false, 0, base);
+    byte(0xc6);
+    memory(0, base, disp);
+    byte(value);
+}
+
+// Values that fit into 32 bits are zero extended by the shorter form.
+void Assembler::immediate(Register dst, uint64_t value) {
+    bool wide = value > 0xffffffff;
+    rex(wide, 0, dst);
+    byte((uint8_t) (0xb8 + (dst & 7)));
+    dword((uint32_t) value);
+    if (wide) {
+        dword((uint32_t) (value >> 32));
+    }
+}
+
+void Assembler::lea(Register dst, Register base, int32_t disp) {
+    rex(true, dst, base);
+    byte(0x8d);
+    memory(dst, base, disp);
+}
+
+void Assembler::alu(Alu op, Register dst, Register src, bool wide) {
+    rex(wide, src, dst);
+    byte((uint8_t) (op << 3 | 1));
+    direct(src, dst);
+}
+
+void Assembler::alu(Alu op, Register dst, int32_t value, bool wide) {
+    rex(wide, 0, dst);
+    byte(0x81);
+    direct(op, dst);
+    dword((uint32_t) value);
+}
+
+void Assembler::test(Register a, Register b, bool wide) {
+    rex(wide, b, a);
+    byte(0x85);
+    direct(b, a);
+}
+
+void Assembler::shift(Shift op, Register dst, uint8_t count) {
+    rex(true, 0, dst);
+    byte(0xc1);
+    direct(op, dst);
+    byte(count);
+}
+
+void Assembler::imul32(Register dst, Register src) {
+    rex(false, dst, src);
+    byte(0x0f);
+    byte(0xaf);
+    direct(dst, src);
+}
+
+// Divides EDX:EAX, sign extended from EAX, the quotient is left in EAX and the remainder in EDX.
+void Assembler::idiv32(Register divisor) {
+    byte(0x99);
+    rex(false, 0, divisor);
+    byte(0xf7);
+    direct(7, divisor);
+}
+
+// Sets the whole register to 0 or 1, dst is one of RAX, RCX, RDX and RBX.
+void Assembler::setcc(Condition condition, Register dst) {
+    byte(0x0f);
+    byte((uint8_t) (0x90 + condition));
+    direct(0, dst);
+    byte(0x0f);
+    byte(0xb6);
+    direct(dst, dst);
+}
+
+void Assembler::push(Register r) {
+    rex(false, 0, r);
+    byte((uint8_t) (0x50 + (r & 7)));
+}
+
+void Assembler::pop(Register r) {
+    rex(false, 0, r);
+    byte((uint8_t) (0x58 + (r & 7)));
+}
+
+void Assembler::call(Register target) {
+    rex(false, 0, target);
+    byte(0xff);
+    direct(2, target);
+}
+
+void Assembler::ret() {
+    byte(0xc3);
+}
+
+void Assembler::jmp(unsigned label) {
+    byte(0xe9);
+    fixups.push_back(make_pair(bytes.size(), label));
+    dword(0);
+}
+
+void Assembler::jcc(Condition condition, unsigned label) {
+    byte(0x0f);
+    byte((uint8_t) (0x80 + condition));
+    fixups.push_back(make_pair(bytes.size(), label));
+    dword(0);
+}
@@ -0,0 +1,102 @@
+#ifndef TEETON_ASSEMBLER_H
+#define TEETON_ASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Registers of x86-64 in the order of their encoding.
+enum Register {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes of jcc and setcc, for signed comparisons.
+enum Condition {
+    CC_E = 0x4, CC_NE = 0x5, CC_S = 0x8, CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf
+};
+
+// Arithmetic instructions by their /digit in the 0x81 group.
+enum Alu {
+    ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+};
+
+enum Shift {
+    SHIFT_SHL = 4, SHIFT_SHR = 5
+};
+
+// Encodes the few x86-64 instructions the JIT needs. Memory operands are [base + disp32],
+// instructions ending with 32 work on the low halves of the registers.
+class Assembler {
+public:
+    unsigned label();
+
+    void bind(unsigned label);
+
+    std::vector<uint8_t> finish();
+
+    void mov(Register dst, Register src);
+
+    void mov32(Register dst, Register src);
+
+    void load(Register dst, Register base, int32_t disp);
+
+    void load32(Register dst, Register base, int32_t disp);
+
+    void loadByte(Register dst, Register base, int32_t disp);
+
+    void store(Register base, int32_t disp, Register src);
+
+    void store32(Register base, int32_t disp, Register src);
+
+    void storeByte(Register base, int32_t disp, uint8_t value);
+
+    void immediate(Register dst, uint64_t value);
+
+    void lea(Register dst, Register base, int32_t disp);
+
+    void alu(Alu op, Register dst, Register src, bool wide = false);
+
+    void alu(Alu op, Register dst, int32_t value, bool wide = false);
+
+    void test(Register a, Register b, bool wide = false);
+
+    void shift(Shift op, Register dst, uint8_t count);
+
+    void imul32(Register dst, Register src);
+
+    void idiv32(Register divisor);
+
+    void setcc(Condition condition, Register dst);
+
+    void push(Register r);
+
+    void pop(Register r);
+
+    void call(Register target);
+
+    void ret();
+
+    void jmp(unsigned label);
+
+    void jcc(Condition condition, unsigned label);
+
+    static Condition negate(Condition condition) { return (Condition) (condition ^ 1); };
+
+private:
+    void byte(uint8_t value) { bytes.push_back(value); };
+
+    void dword(uint32_t value);
+
+    void rex(bool wide, int reg, int rm);
+
+    void direct(int reg, int rm);
+
+    void memory(int reg, Register base, int32_t disp);
+
+    std::vector<uint8_t> bytes;
+    std::vector<int> labels;
+    std::vector<std::pair<size_t, unsigned>> fixups;  // rel32 operands waiting for their label
+};
+
+#endif //TEETON_ASSEMBLER_H
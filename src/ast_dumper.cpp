@@ -0,0 +1,159 @@
+#include "ast_dumper.h"
+#include "node.h"
+
+using namespace std;
+
+void AstDumper::dump(AbstractNode *root, SymbolTable *symbols, ostream &os) {
+    AstDumper dumper(symbols, os);
+    root->dump(&dumper);
+}
+
+void AstDumper::open(const string &label) {
+    os << string(indent * 2, ' ') << label << endl;
+    indent++;
+}
+
+static string escape(char c) {
+    switch (c) {
+        case '\n':
+            return "\\n";
+        case '\t':
+            return "\\t";
+        case '\\':
+            return "\\\\";
+        default:
+            return string(1, c);
+    }
+}
+
+// Constants are printed as they are written in the program, lists of the pool are strings.
+string AstDumper::constant(Value value) {
+    switch (value.type()) {
+        case INT:
+            return to_string(value.intValue());
+        case CHAR:
+            return value.charValue() == '\'' ? "'\\''" : "'" + escape(value.charValue()) + "'";
+        case BOOL:
+            return value.boolValue() ? "True" : "False";
+        default: {
+            TypeList *list = value.listValue();
+            string chars;
+            for (unsigned i = 0; i < list->size(); i++) {
+                char c = list->get(i).charValue();
+                chars += c == '"' ? "\\\"" : escape(c);
+            }
+            return "\"" + chars + "\"";
+        }
+    }
+}
+
+string AstDumper::symbol(Operator op) {
+    static const char *const Symbols[] = {"+", "-", "*", "/", "%", "==", "!=", "===", ">", "<", ">=", "<=", "&&", "||"};
+    return Symbols[op];
+}
+
+// -- Nodes --------------------------------------------------------------------
+
+void NodeBlock::dump(AstDumper *dumper) {
+    dumper->open("block");
+    for (auto const &node : *nodes) {
+        node->dump(dumper);
+    }
+    dumper->close();
+}
+
+void NodeVariableDefinition::dump(AstDumper *dumper) {
+    dumper->open(dumper->name(slot) + " =");
+    value->dump(dumper);
+    dumper->close();
+}
+
+void NodeVariableName::dump(AstDumper *dumper) {
+    dumper->line(dumper->name(slot));
+}
+
+void NodePrint::dump(AstDumper *dumper) {
+    dumper->open(breakLine ? "println" : "print");
+    value->dump(dumper);
+    dumper->close();
+}
+
+void NodeBinaryOperator::dump(AstDumper *dumper) {
+    dumpOperator(dumper, "");
+}
+
+void NodeBinaryOperator::dumpOperator(AstDumper *dumper, const string &operands) {
+    dumper->open(operands + AstDumper::symbol(op));
+    a->dump(dumper);
+    b->dump(dumper);
+    dumper->close();
+}
+
+void NodeNotOperator::dump(AstDumper *dumper) {
+    dumper->open("!");
+    a->dump(dumper);
+    dumper->close();
+}
+
+void NodeConstant::dump(AstDumper *dumper) {
+    dumper->line(AstDumper::constant(value));
+}
+
+void NodeWhile::dump(AstDumper *dumper) {
+    dumper->open("while");
+    condition->dump(dumper);
+    block->dump(dumper);
+    dumper->close();
+}
+
+void NodeIfElse::dump(AstDumper *dumper) {
+    dumper->open("if");
+    condition->dump(dumper);
+    ifBlock->dump(dumper);
+    elseBlock->dump(dumper);
+    dumper->close();
+}
+
+void NodeScanInt::dump(AstDumper *dumper) {
+    dumper->line("scan_int");
+}
+
+void NodeScanChar::dump(AstDumper *dumper) {
+    dumper->line("scan_char");
+}
+
+void NodeScanString::dump(AstDumper *dumper) {
+    dumper->line("scan_string");
+}
+
+void NodeBreak::dump(AstDumper *dumper) {
+    dumper->line("break");
+}
+
+void NodeLen::dump(AstDumper *dumper) {
+    dumper->open("len");
+    expression->dump(dumper);
+    dumper->close();
+}
+
+void NodeAppend::dump(AstDumper *dumper) {
+    dumper->open("append");
+    listExpression->dump(dumper);
+    valueExpression->dump(dumper);
+    dumper->close();
+}
+
+void NodeGet::dump(AstDumper *dumper) {
+    dumper->open("get");
+    listExpression->dump(dumper);
+    indexExpression->dump(dumper);
+    dumper->close();
+}
+
+void NodeSet::dump(AstDumper *dumper) {
+    dumper->open("set");
+    listExpression->dump(dumper);
+    indexExpression->dump(dumper);
+    valueExpression->dump(dumper);
+    dumper->close();
+}
@@ -0,0 +1,39 @@
+#ifndef TEETON_AST_DUMPER_H
+#define TEETON_AST_DUMPER_H
+
+#include <ostream>
+#include <string>
+
+#include "enums.h"
+#include "symbol_table.h"
+#include "type.h"
+
+class AbstractNode;
+
+// Prints the tree one node per line, the operands and statements of a node are indented below it.
+class AstDumper {
+public:
+    static void dump(AbstractNode *root, SymbolTable *symbols, std::ostream &os);
+
+    void line(const std::string &label) { open(label); close(); };
+
+    // the nodes dumped until close are children of the node
+    void open(const std::string &label);
+
+    void close() { indent--; };
+
+    std::string name(unsigned slot) { return symbols->name(slot); };
+
+    static std::string constant(Value value);
+
+    static std::string symbol(Operator op);
+
+private:
+    AstDumper(SymbolTable *symbols, std::ostream &os) : symbols(symbols), os(os) { };
+
+    SymbolTable *symbols;
+    std::ostream &os;
+    unsigned indent = 0;
+};
+
+#endif //TEETON_AST_DUMPER_H
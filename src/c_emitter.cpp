@@ -0,0 +1,227 @@
+#include <iomanip>
+
+#include "c_emitter.h"
+#include "node.h"
+
+using namespace std;
+
+// Functions of the runtime in the order of Operator.
+static const char *OperatorFunctions[] = {
+        "tt_add", "tt_sub", "tt_mul", "tt_div", "tt_mod", "tt_eq", "tt_neq", "tt_eqeq", "tt_gt", "tt_lt", "tt_gte",
+        "tt_lte", "tt_and", "tt_or"
+};
+
+// Variables live in V with their defined flags in D, both indexed by slot. Arrays get one extra
+// element so that a program without variables is valid C.
+void CEmitter::emit(AbstractNode *root, SymbolTable *symbols, ostream &os) {
+    CEmitter emitter;
+    root->emitC(&emitter);
+
+    unsigned count = symbols->size();
+    os << "/* generated by teeton --emit-c, build with cc -O2 -Iruntime program.c runtime/teeton.c */" << endl;
+    os << "#include \"teeton.h\"" << endl << endl;
+    os << "static const char *names[" << count + 1 << "] = {";
+    for (unsigned slot = 0; slot < count; slot++) {
+        os << literal(symbols->name(slot)) << ", ";
+    }
+    os << "0};" << endl;
+    os << "static tt_value V[" << count + 1 << "];" << endl;
+    os << "static char D[" << count + 1 << "];" << endl;
+    os << emitter.globals.str() << endl;
+    os << "int main(void) {" << endl;
+    os << emitter.initializers.str();
+    os << "    tt_init(V, D, " << count << ", names);" << endl;
+    os << emitter.body.str();
+    os << "    return tt_exit();" << endl;
+    os << "}" << endl;
+}
+
+// Scalars are emitted as their bits. Every string literal is a constant list of its own, literals
+// with the same chars share the storage like in the constant pool.
+string CEmitter::constant(Value value) {
+    if (!value.isList()) {
+        ostringstream os;
+        os << "UINT64_C(0x" << hex << value.bits << ")";
+        return os.str();
+    }
+
+    TypeList *list = value.listValue();
+    string chars;
+    for (unsigned i = 0; i < list->size(); i++) {
+        chars += list->get(i).charValue();
+    }
+
+    string name = "C" + to_string(constants++);
+    globals << "static tt_value " << name << ";" << endl;
+
+    auto it = strings.find(chars);
+    if (it != strings.end()) {
+        initializers << "    " << name << " = tt_share(" << it->second << ");" << endl;
+    } else {
+        initializers << "    " << name << " = tt_string(" << literal(chars) << ", " << chars.size() << ");" << endl;
+        strings[chars] = name;
+    }
+    return name;
+}
+
+string CEmitter::temporary(const string &expression) {
+    string name = "t" + to_string(temporaries++);
+    line("tt_value " + name + " = " + expression + ";");
+    return name;
+}
+
+void CEmitter::line(const string &code) {
+    body << string(indent * 4, ' ') << code << endl;
+}
+
+void CEmitter::open(const string &code) {
+    line(code);
+    indent++;
+}
+
+void CEmitter::close(const string &code) {
+    indent--;
+    line(code);
+}
+
+void CEmitter::reopen(const string &code) {
+    close(code);
+    indent++;
+}
+
+string CEmitter::call(const string &function, const string &a) {
+    return function + "(" + a + ")";
+}
+
+string CEmitter::call(const string &function, const string &a, const string &b) {
+    return function + "(" + a + ", " + b + ")";
+}
+
+string CEmitter::call(const string &function, const string &a, const string &b, const string &c) {
+    return function + "(" + a + ", " + b + ", " + c + ")";
+}
+
+// Octal escapes do not swallow the following digits like hexadecimal ones do.
+string CEmitter::literal(const string &chars) {
+    ostringstream os;
+    os << '"';
+    for (char c : chars) {
+        if (c == '"' || c == '\\' || c == '?' || c < ' ' || c > '~') {
+            os << '\\' << oct << setw(3) << setfill('0') << (unsigned) (unsigned char) c << dec;
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
+// -----------------------------------------------------------------------------
+
+// Statements start at a safepoint like in the tree walker, no temporary is live there.
+string NodeBlock::emitC(CEmitter *emitter) {
+    for (auto const &node : *nodes) {
+        emitter->line("TT_SAFEPOINT();");
+        node->emitC(emitter);
+    }
+    return "TT_NULL";
+}
+
+string NodeVariableDefinition::emitC(CEmitter *emitter) {
+    string evaluated = value->emitC(emitter);
+    emitter->line("V[" + to_string(slot) + "] = " + CEmitter::call("tt_materialize", evaluated) + ";");
+    emitter->line("D[" + to_string(slot) + "] = 1;");
+    return "TT_NULL";
+}
+
+string NodeVariableName::emitC(CEmitter *emitter) {
+    string index = to_string(slot);
+    return emitter->temporary("D[" + index + "] ? V[" + index + "] : tt_undefined(" + index + ")");
+}
+
+string NodePrint::emitC(CEmitter *emitter) {
+    string evaluated = value->emitC(emitter);
+    emitter->line(CEmitter::call(breakLine ? "tt_println" : "tt_print", evaluated) + ";");
+    return "TT_NULL";
+}
+
+string NodeBinaryOperator::emitC(CEmitter *emitter) {
+    string t1 = a->emitC(emitter);
+    string t2 = b->emitC(emitter);
+    return emitter->temporary(CEmitter::call(OperatorFunctions[op], t1, t2));
+}
+
+string NodeNotOperator::emitC(CEmitter *emitter) {
+    string t = a->emitC(emitter);
+    return emitter->temporary(CEmitter::call("tt_not", t));
+}
+
+string NodeConstant::emitC(CEmitter *emitter) {
+    return emitter->constant(value);
+}
+
+string NodeWhile::emitC(CEmitter *emitter) {
+    emitter->open("for (;;) {");
+    emitter->line("TT_SAFEPOINT();");
+    string evaluated = condition->emitC(emitter);
+    emitter->line("if (!" + CEmitter::call("tt_condition", evaluated) + ") break;");
+
+    emitter->beginLoop();
+    block->emitC(emitter);
+    emitter->endLoop();
+    emitter->close();
+    return "TT_NULL";
+}
+
+string NodeIfElse::emitC(CEmitter *emitter) {
+    string evaluated = condition->emitC(emitter);
+    emitter->open("if (" + CEmitter::call("tt_condition", evaluated) + ") {");
+    ifBlock->emitC(emitter);
+    emitter->reopen("} else {");
+    elseBlock->emitC(emitter);
+    emitter->close();
+    return "TT_NULL";
+}
+
+string NodeScanInt::emitC(CEmitter *emitter) {
+    return emitter->temporary("tt_scan_int()");
+}
+
+string NodeScanChar::emitC(CEmitter *emitter) {
+    return emitter->temporary("tt_scan_char()");
+}
+
+string NodeScanString::emitC(CEmitter *emitter) {
+    return emitter->temporary("tt_scan_string()");
+}
+
+string NodeBreak::emitC(CEmitter *emitter) {
+    emitter->line(emitter->inLoop() ? "break;" : "tt_break_outside();");
+    return "TT_NULL";
+}
+
+string NodeLen::emitC(CEmitter *emitter) {
+    string list = expression->emitC(emitter);
+    return emitter->temporary(CEmitter::call("tt_len", list));
+}
+
+string NodeAppend::emitC(CEmitter *emitter) {
+    string list = listExpression->emitC(emitter);
+    string value = valueExpression->emitC(emitter);
+    emitter->line(CEmitter::call("tt_append", list, value) + ";");
+    return "TT_NULL";
+}
+
+string NodeGet::emitC(CEmitter *emitter) {
+    string list = listExpression->emitC(emitter);
+    string index = indexExpression->emitC(emitter);
+    return emitter->temporary(CEmitter::call("tt_get", list, index));
+}
+
+string NodeSet::emitC(CEmitter *emitter) {
+    string list = listExpression->emitC(emitter);
+    string index = indexExpression->emitC(emitter);
+    string value = valueExpression->emitC(emitter);
+    emitter->line(CEmitter::call("tt_set", list, index, value) + ";");
+    return "TT_NULL";
+}
@@ -0,0 +1,62 @@
+#ifndef TEETON_C_EMITTER_H
+#define TEETON_C_EMITTER_H
+
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "symbol_table.h"
+#include "type.h"
+
+class AbstractNode;
+
+// Translates the tree into a C program linked with the runtime in runtime/teeton.c. Every node emits
+// the statements computing its value and returns the C expression of the value, statements return TT_NULL.
+// Each intermediate value gets its own temporary, so operands are evaluated in the order of the interpreter.
+class CEmitter {
+public:
+    static void emit(AbstractNode *root, SymbolTable *symbols, std::ostream &os);
+
+    std::string constant(Value value);
+
+    std::string temporary(const std::string &expression);
+
+    void line(const std::string &code);
+
+    void open(const std::string &code);
+
+    void close(const std::string &code = "}");
+
+    // closes the block and opens another one, e.g. for else
+    void reopen(const std::string &code);
+
+    void beginLoop() { loops++; };
+
+    void endLoop() { loops--; };
+
+    bool inLoop() { return loops > 0; };
+
+    static std::string call(const std::string &function, const std::string &a);
+
+    static std::string call(const std::string &function, const std::string &a, const std::string &b);
+
+    static std::string call(const std::string &function, const std::string &a, const std::string &b,
+                            const std::string &c);
+
+private:
+    CEmitter() { };
+
+    static std::string literal(const std::string &chars);
+
+    std::ostringstream globals;
+    std::ostringstream initializers;
+    std::ostringstream body;
+    std::unordered_map<std::string, std::string> strings;  // first constant of every string literal
+    unsigned constants = 0;
+    unsigned temporaries = 0;
+    unsigned indent = 1;
+    unsigned loops = 0;
+};
+
+#endif //TEETON_C_EMITTER_H
@@ -0,0 +1,680 @@
+#include "closure.h"
+#include "environment.h"
+#include "node.h"
+
+using namespace std;
+
+// -- Operands -----------------------------------------------------------------
+
+// Operands known when the closure is built. Pure operands are read without running any code, so
+// nothing can allocate between reading them and the first operand needs no root. Reading a variable
+// can fail, but has no effect, so pure operands are checked for an abrupt completion together.
+
+struct IntConstantOperand {
+    Value value;
+
+    ALWAYS_INLINE Value operator()(Environment *env) const { return value; };
+
+    static const bool Pure = true;
+    static const bool Int = true;
+};
+
+struct ConstantOperand {
+    Value value;
+
+    ALWAYS_INLINE Value operator()(Environment *env) const { return value; };
+
+    static const bool Pure = true;
+    static const bool Int = false;
+};
+
+struct VariableOperand {
+    unsigned slot;
+
+    ALWAYS_INLINE Value operator()(Environment *env) const { return env->getVariable(slot); };
+
+    static const bool Pure = true;
+    static const bool Int = false;
+};
+
+struct ClosureOperand {
+    Closure closure;
+
+    ALWAYS_INLINE Value operator()(Environment *env) const { return closure(env); };
+
+    static const bool Pure = false;
+    static const bool Int = false;
+};
+
+// Calls build with the most specific operand for the node.
+template<class Result, class Builder>
+static Result resolve(AbstractNode *node, const Builder &build) {
+    if (NodeConstant *constant = dynamic_cast<NodeConstant *>(node)) {
+        if (constant->getValue().type() == INT) {
+            return build(IntConstantOperand{constant->getValue()});
+        }
+        return build(ConstantOperand{constant->getValue()});
+    }
+    if (NodeVariableName *variable = dynamic_cast<NodeVariableName *>(node)) {
+        return build(VariableOperand{variable->getSlot()});
+    }
+    return build(ClosureOperand{node->close()});
+}
+
+template<class Operand>
+ALWAYS_INLINE inline static bool isInt(Value value) {
+    return Operand::Int || value.type() == INT;
+}
+
+// -- Operators ----------------------------------------------------------------
+
+// Ints and bools are computed inline, other operands go through NodeBinaryOperator::apply.
+
+#define INT_OPERATOR(name, op, result) \
+    struct name { \
+        static const Operator Op = op; \
+        template<class A, class B> \
+        ALWAYS_INLINE static bool accepts(Value t1, Value t2) { return isInt<A>(t1) && isInt<B>(t2); } \
+        ALWAYS_INLINE static Value apply(Environment *env, Value t1, Value t2) { \
+            int a = t1.intValue(); \
+            int b = t2.intValue(); \
+            return result; \
+        }; \
+    };
+
+#define INT_COMPARISON(name, op, comparison) \
+    struct name { \
+        static const Operator Op = op; \
+        template<class A, class B> \
+        ALWAYS_INLINE static bool accepts(Value t1, Value t2) { return isInt<A>(t1) && isInt<B>(t2); } \
+        ALWAYS_INLINE static bool compare(Value t1, Value t2) { \
+            int a = t1.intValue(); \
+            int b = t2.intValue(); \
+            return comparison; \
+        }; \
+        ALWAYS_INLINE static Value apply(Environment *env, Value t1, Value t2) { return env->makeBool(compare(t1, t2)); }; \
+    };
+
+#define BOOL_OPERATOR(name, op, result) \
+    struct name { \
+        static const Operator Op = op; \
+        template<class A, class B> \
+        ALWAYS_INLINE static bool accepts(Value t1, Value t2) { return t1.type() == BOOL && t2.type() == BOOL; } \
+        ALWAYS_INLINE static Value apply(Environment *env, Value t1, Value t2) { \
+            bool a = t1.boolValue(); \
+            bool b = t2.boolValue(); \
+            return env->makeBool(result); \
+        }; \
+    };
+
+INT_OPERATOR(Add, ADD, env->makeInt(a + b))
+INT_OPERATOR(Sub, SUB, env->makeInt(a - b))
+INT_OPERATOR(Mul, MUL, env->makeInt(a * b))
+INT_OPERATOR(Div, DIV, env->makeInt(a / b))
+INT_OPERATOR(Mod, MOD, env->makeInt(a % b))
+INT_COMPARISON(Eq, EQ, a == b)
+INT_COMPARISON(Neq, NEQ, a != b)
+INT_COMPARISON(Gt, GT, a > b)
+INT_COMPARISON(Lt, LT, a < b)
+INT_COMPARISON(Gte, GTE, a >= b)
+INT_COMPARISON(Lte, LTE, a <= b)
+BOOL_OPERATOR(And, AND, a && b)
+BOOL_OPERATOR(Or, OR, a || b)
+
+struct Same {
+    static const Operator Op = EQEQ;
+
+    template<class A, class B>
+    ALWAYS_INLINE static bool accepts(Value t1, Value t2) { return false; }
+
+    static Value apply(Environment *env, Value t1, Value t2) { return Value(); };
+};
+
+template<class Op, class A, class B>
+ALWAYS_INLINE inline static Value operate(Environment *env, Value &t1, Value t2, SourceLocation *site) {
+    if (Op::template accepts<A, B>(t1, t2)) {
+        return Op::apply(env, t1, t2);
+    }
+    return NodeBinaryOperator::apply(env, Op::Op, t1, t2, site);
+}
+
+template<class Op, class A, class B>
+static Closure binary(A a, B b, SourceLocation *site) {
+    if (B::Pure) {
+        return [a, b, site](Environment *env) ALWAYS_INLINE -> Value {
+            Value t1 = a(env);
+            Value t2 = b(env);
+            if (env->abrupt()) {
+                return Value();
+            }
+            return operate<Op, A, B>(env, t1, t2, site);
+        };
+    }
+    return [a, b, site](Environment *env) ALWAYS_INLINE -> Value {
+        Root t1(env, a(env));
+        if (env->abrupt()) {
+            return Value();
+        }
+        Value t2 = b(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+        return operate<Op, A, B>(env, t1.value, t2, site);
+    };
+}
+
+template<class Op, class A, class B>
+static Test comparison(A a, B b, SourceLocation *site) {
+    return [a, b, site](Environment *env) ALWAYS_INLINE -> bool {
+        Root t1(env, a(env));
+        if (env->abrupt()) {
+            return false;
+        }
+        Value t2 = b(env);
+        if (env->abrupt()) {
+            return false;
+        }
+        if (Op::template accepts<A, B>(t1.value, t2)) {
+            return Op::compare(t1.value, t2);
+        }
+        return NodeBinaryOperator::apply(env, Op::Op, t1.value, t2, site).boolValue();
+    };
+}
+
+template<class Op, class A, class B>
+static Test pureComparison(A a, B b, SourceLocation *site) {
+    return [a, b, site](Environment *env) ALWAYS_INLINE -> bool {
+        Value t1 = a(env);
+        Value t2 = b(env);
+        if (env->abrupt()) {
+            return false;
+        }
+        if (Op::template accepts<A, B>(t1, t2)) {
+            return Op::compare(t1, t2);
+        }
+        return NodeBinaryOperator::apply(env, Op::Op, t1, t2, site).boolValue();
+    };
+}
+
+// Resolves the second operand once the first one is known.
+template<class Op, class A>
+struct BinarySecond {
+    A a;
+    SourceLocation *site;
+
+    template<class B>
+    Closure operator()(B b) const { return binary<Op, A, B>(a, b, site); }
+};
+
+template<class Op>
+struct BinaryFirst {
+    AbstractNode *b;
+    SourceLocation *site;
+
+    template<class A>
+    Closure operator()(A a) const { return resolve<Closure>(b, BinarySecond<Op, A>{a, site}); }
+};
+
+template<class Op, class A>
+struct ComparisonSecond {
+    A a;
+    SourceLocation *site;
+
+    template<class B>
+    Test operator()(B b) const {
+        return B::Pure ? pureComparison<Op, A, B>(a, b, site) : comparison<Op, A, B>(a, b, site);
+    }
+};
+
+template<class Op>
+struct ComparisonFirst {
+    AbstractNode *b;
+    SourceLocation *site;
+
+    template<class A>
+    Test operator()(A a) const { return resolve<Test>(b, ComparisonSecond<Op, A>{a, site}); }
+};
+
+// -----------------------------------------------------------------------------
+
+// A test which does not complete normally is false, the loop or the branch checks the completion.
+Test AbstractNode::test() {
+    Closure closure = close();
+    return [closure](Environment *env) ALWAYS_INLINE -> bool {
+        Value evaluated = closure(env);
+        if (env->abrupt()) {
+            return false;
+        }
+
+        if (evaluated.type() != BOOL) {
+            env->fail("Cannot use non-bool value for condition.");
+            return false;
+        }
+
+        return evaluated.boolValue();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+// Blocks of one or two nodes, the bodies of most loops and branches, call them directly.
+Closure NodeBlock::close() {
+    vector<Closure> closures;
+    for (auto const &node : *nodes) {
+        closures.push_back(node->close());
+    }
+
+    if (closures.empty()) {
+        return [](Environment *env) ALWAYS_INLINE -> Value { return Value(); };
+    }
+    if (closures.size() == 1) {
+        Closure first = closures[0];
+        return [first](Environment *env) ALWAYS_INLINE -> Value {
+            if (!env->safepoint()) {
+                return Value();
+            }
+            return first(env);
+        };
+    }
+    if (closures.size() == 2) {
+        Closure first = closures[0];
+        Closure second = closures[1];
+        return [first, second](Environment *env) ALWAYS_INLINE -> Value {
+            if (!env->safepoint()) {
+                return Value();
+            }
+            first(env);
+            if (env->abrupt()) {
+                return Value();
+            }
+            if (!env->safepoint()) {
+                return Value();
+            }
+            return second(env);
+        };
+    }
+    return [closures](Environment *env) ALWAYS_INLINE -> Value {
+        Value last;
+        for (auto const &closure : closures) {
+            if (!env->safepoint()) {
+                return Value();
+            }
+            last = closure(env);
+            if (env->abrupt()) {
+                return Value();
+            }
+        }
+        return last;
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+template<class V>
+static Closure define(V value, unsigned slot, SourceLocation *site) {
+    return [value, slot, site](Environment *env) ALWAYS_INLINE -> Value {
+        Value evaluated = value(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+        env->site = site;
+        env->setVariable(slot, evaluated);
+        return Value();
+    };
+}
+
+struct DefineBuilder {
+    unsigned slot;
+    SourceLocation *site;
+
+    template<class V>
+    Closure operator()(V value) const { return define(value, slot, site); }
+};
+
+Closure NodeVariableDefinition::close() {
+    return resolve<Closure>(value, DefineBuilder{slot, &location});
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeVariableName::close() {
+    unsigned slot = this->slot;
+    return [slot](Environment *env) ALWAYS_INLINE -> Value {
+        return env->getVariable(slot);
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodePrint::close() {
+    Closure value = this->value->close();
+    if (breakLine) {
+        return [value](Environment *env) ALWAYS_INLINE -> Value {
+            Value evaluated = value(env);
+            if (!env->abrupt()) {
+                cout << evaluated.toString() << endl;
+            }
+            return Value();
+        };
+    }
+    return [value](Environment *env) ALWAYS_INLINE -> Value {
+        Value evaluated = value(env);
+        if (!env->abrupt()) {
+            cout << evaluated.toString();
+        }
+        return Value();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+#define BINARY_CASE(op, name) \
+    case op: \
+        return resolve<Closure>(a, BinaryFirst<name>{b, &location});
+
+#define COMPARISON_CASE(op, name) \
+    case op: \
+        return resolve<Test>(a, ComparisonFirst<name>{b, &location});
+
+Closure NodeBinaryOperator::close() {
+    switch (op) {
+        BINARY_CASE(ADD, Add)
+        BINARY_CASE(SUB, Sub)
+        BINARY_CASE(MUL, Mul)
+        BINARY_CASE(DIV, Div)
+        BINARY_CASE(MOD, Mod)
+        BINARY_CASE(EQ, Eq)
+        BINARY_CASE(NEQ, Neq)
+        BINARY_CASE(EQEQ, Same)
+        BINARY_CASE(GT, Gt)
+        BINARY_CASE(LT, Lt)
+        BINARY_CASE(GTE, Gte)
+        BINARY_CASE(LTE, Lte)
+        BINARY_CASE(AND, And)
+        BINARY_CASE(OR, Or)
+    }
+    return nullptr;
+}
+
+// Comparisons in conditions do not make a bool value.
+Test NodeBinaryOperator::test() {
+    switch (op) {
+        COMPARISON_CASE(EQ, Eq)
+        COMPARISON_CASE(NEQ, Neq)
+        COMPARISON_CASE(GT, Gt)
+        COMPARISON_CASE(LT, Lt)
+        COMPARISON_CASE(GTE, Gte)
+        COMPARISON_CASE(LTE, Lte)
+        default:
+            return AbstractNode::test();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeNotOperator::close() {
+    Closure a = this->a->close();
+    return [a](Environment *env) ALWAYS_INLINE -> Value {
+        Value t = a(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        if (t.type() != BOOL) {
+            return env->fail("Using not operator with non-boolean variable.");
+        }
+
+        return env->makeBool(!t.boolValue());
+    };
+}
+
+Test NodeNotOperator::test() {
+    Closure a = this->a->close();
+    return [a](Environment *env) ALWAYS_INLINE -> bool {
+        Value t = a(env);
+        if (env->abrupt()) {
+            return false;
+        }
+
+        if (t.type() != BOOL) {
+            env->fail("Using not operator with non-boolean variable.");
+            return false;
+        }
+
+        return !t.boolValue();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeConstant::close() {
+    Value value = this->value;
+    return [value](Environment *env) ALWAYS_INLINE -> Value {
+        return value;
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeWhile::close() {
+    Test condition = this->condition->test();
+    Closure block = this->block->close();
+    return [condition, block](Environment *env) ALWAYS_INLINE -> Value {
+        for (; ;) {
+            if (!env->safepoint() || !condition(env)) {
+                return Value();
+            }
+
+            block(env);
+            if (env->completion == BREAK_COMPLETION) {
+                env->completion = NORMAL_COMPLETION;
+                return Value();
+            }
+            if (env->abrupt()) {
+                return Value();
+            }
+        }
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeIfElse::close() {
+    Test condition = this->condition->test();
+    Closure ifBlock = this->ifBlock->close();
+    Closure elseBlock = this->elseBlock->close();
+    return [condition, ifBlock, elseBlock](Environment *env) ALWAYS_INLINE -> Value {
+        bool taken = condition(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        if (taken) {
+            ifBlock(env);
+        } else {
+            elseBlock(env);
+        }
+        return Value();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeScanInt::close() {
+    return [this](Environment *env) ALWAYS_INLINE -> Value {
+        return evaluate(env);
+    };
+}
+
+Closure NodeScanChar::close() {
+    return [this](Environment *env) ALWAYS_INLINE -> Value {
+        return evaluate(env);
+    };
+}
+
+Closure NodeScanString::close() {
+    return [this](Environment *env) ALWAYS_INLINE -> Value {
+        return evaluate(env);
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeBreak::close() {
+    return [](Environment *env) ALWAYS_INLINE -> Value {
+        env->completion = BREAK_COMPLETION;
+        return Value();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeLen::close() {
+    Closure expression = this->expression->close();
+    return [expression](Environment *env) ALWAYS_INLINE -> Value {
+        Value result = expression(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        if (result.type() != LIST) {
+            return env->fail("len can be only used with lists.");
+        }
+
+        return env->makeInt((int) result.listValue()->size());
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeAppend::close() {
+    Closure listExpression = this->listExpression->close();
+    Closure valueExpression = this->valueExpression->close();
+    SourceLocation *site = &location;
+    return [listExpression, valueExpression, site](Environment *env) ALWAYS_INLINE -> Value {
+        Root listResult(env, listExpression(env));
+        if (env->abrupt()) {
+            return Value();
+        }
+        Root valueResult(env, valueExpression(env));
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        if (listResult.value.type() != LIST) {
+            return env->fail("First argument of append must be list.");
+        }
+
+        env->site = site;
+        listResult.value = env->materialize(listResult.value);
+        valueResult.value = env->materialize(valueResult.value);
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        TypeList *list = listResult.value.listValue();
+        list->append(valueResult.value);
+        env->writeBarrier(list, list->size() - 1, valueResult.value);
+        return Value();
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+template<class L, class I>
+ALWAYS_INLINE inline static Value get(Environment *env, Value listResult, Value indexResult) {
+    if (listResult.type() != LIST) {
+        return env->fail("First argument of append must be list.");
+    }
+
+    if (!isInt<I>(indexResult)) {
+        return env->fail("Second argument of get must be int.");
+    }
+
+    return listResult.listValue()->get((unsigned) indexResult.intValue());
+}
+
+struct GetSecond {
+    AbstractNode *index;
+
+    template<class L>
+    struct Index {
+        L list;
+
+        template<class I>
+        Closure operator()(I index) const {
+            L list = this->list;
+            if (I::Pure) {
+                return [list, index](Environment *env) ALWAYS_INLINE -> Value {
+                    Value listResult = list(env);
+                    Value indexResult = index(env);
+                    if (env->abrupt()) {
+                        return Value();
+                    }
+                    return get<L, I>(env, listResult, indexResult);
+                };
+            }
+            return [list, index](Environment *env) ALWAYS_INLINE -> Value {
+                Root listResult(env, list(env));
+                if (env->abrupt()) {
+                    return Value();
+                }
+                Value indexResult = index(env);
+                if (env->abrupt()) {
+                    return Value();
+                }
+                return get<L, I>(env, listResult.value, indexResult);
+            };
+        }
+    };
+
+    template<class L>
+    Closure operator()(L list) const { return resolve<Closure>(index, Index<L>{list}); }
+};
+
+Closure NodeGet::close() {
+    return resolve<Closure>(listExpression, GetSecond{indexExpression});
+}
+
+// -----------------------------------------------------------------------------
+
+Closure NodeSet::close() {
+    Closure listExpression = this->listExpression->close();
+    Closure indexExpression = this->indexExpression->close();
+    Closure valueExpression = this->valueExpression->close();
+    SourceLocation *site = &location;
+    return [listExpression, indexExpression, valueExpression, site](Environment *env) ALWAYS_INLINE -> Value {
+        Root listResult(env, listExpression(env));
+        if (env->abrupt()) {
+            return Value();
+        }
+        Value indexResult = indexExpression(env);
+        if (env->abrupt()) {
+            return Value();
+        }
+        Root valueResult(env, valueExpression(env));
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        if (listResult.value.type() != LIST) {
+            return env->fail("First argument of set must be list.");
+        }
+
+        if (indexResult.type() != INT) {
+            return env->fail("Second argument of set must be int.");
+        }
+
+        env->site = site;
+        listResult.value = env->materialize(listResult.value);
+        valueResult.value = env->materialize(valueResult.value);
+        if (env->abrupt()) {
+            return Value();
+        }
+
+        TypeList *list = listResult.value.listValue();
+        list->set((unsigned) indexResult.intValue(), valueResult.value);
+        env->writeBarrier(list, (unsigned) indexResult.intValue(), valueResult.value);
+        return Value();
+    };
+}
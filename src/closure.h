@@ -0,0 +1,47 @@
+#ifndef TEETON_CLOSURE_H
+#define TEETON_CLOSURE_H
+
+#include <cstddef>
+#include <memory>
+
+#include "type.h"
+
+// Bodies of closures and the helpers they call are inlined into the call through the pointer, even in
+// a debug build, so running a node costs one indirect call.
+#if defined(__GNUC__)
+#define ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE
+#endif
+
+// A lambda called through one function pointer. It is shared by copies like std::function, but calling it
+// does not go through the layers of std::function, which are not inlined in a debug build.
+template<class R>
+class Callable {
+public:
+    Callable() : target(nullptr), invoke(nullptr) { };
+
+    Callable(std::nullptr_t) : target(nullptr), invoke(nullptr) { };
+
+    template<class F>
+    Callable(F function) : owner(std::make_shared<F>(function)), target(owner.get()), invoke(&call<F>) { }
+
+    ALWAYS_INLINE R operator()(Environment *env) const { return invoke(target, env); };
+
+private:
+    template<class F>
+    static R call(void *function, Environment *env) { return (*(F *) function)(env); }
+
+    std::shared_ptr<void> owner;
+    void *target;
+    R (*invoke)(void *function, Environment *env);
+};
+
+// Nodes prepared for the closure engine. Every node is turned into a callable once, with its operator
+// and the kinds of its operands already resolved, so running it does not dispatch on them again.
+typedef Callable<Value> Closure;
+
+// Condition of a loop or a branch, comparisons give a bool without making a bool value.
+typedef Callable<bool> Test;
+
+#endif //TEETON_CLOSURE_H
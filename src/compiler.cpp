@@ -0,0 +1,301 @@
+#include "compiler.h"
+#include "node.h"
+
+using namespace std;
+
+Compiler::Compiler(Chunk *chunk) : chunk(chunk) {
+    nullRegister = constant(Value());
+}
+
+bool Compiler::compile(AbstractNode *root, Chunk *chunk) {
+    Compiler compiler(chunk);
+    unsigned result = root->compile(&compiler);
+    compiler.finish(result);
+    return !compiler.tooLarge;
+}
+
+unsigned Compiler::constant(Value value) {
+    chunk->constants.push_back(value);
+    return ConstantOperand | (unsigned) (chunk->constants.size() - 1);
+}
+
+unsigned Compiler::temporary() {
+    temporaries = max(temporaries, top + 1);
+    return top++;
+}
+
+// Value of the node in a temporary register. Instructions which write their operands back
+// after an allocation get a copy of constants.
+unsigned Compiler::temporary(AbstractNode *node) {
+    unsigned value = node->compile(this);
+    if (value & ConstantOperand) {
+        unsigned copy = temporary();
+        emit(OP_MOVE, copy, value);
+        return copy;
+    }
+    return value;
+}
+
+void Compiler::emit(Opcode opcode, unsigned a, unsigned b, unsigned c, SourceLocation *site) {
+    code.push_back({opcode, a, b, c});
+    chunk->sites.push_back(site);
+}
+
+unsigned Compiler::jump(Opcode opcode, unsigned condition) {
+    if (opcode == OP_JUMP_IF_FALSE && !code.empty() && code.back().a == condition) {
+        Opcode last = code.back().opcode;
+        if (last >= OP_EQ && last <= OP_LTE && last != OP_EQEQ) {
+            code.back().opcode = (Opcode) (last < OP_EQEQ ? OP_TEST_EQ + (last - OP_EQ) : OP_TEST_GT + (last - OP_GT));
+            opcode = OP_JUMP;
+        }
+    }
+    emit(opcode, condition);
+    return here() - 1;
+}
+
+void Compiler::jumpTo(unsigned target) {
+    emit(OP_JUMP, 0, target & 0xffff, target >> 16);
+}
+
+void Compiler::patch(unsigned jump) {
+    code[jump].b = here() & 0xffff;
+    code[jump].c = here() >> 16;
+}
+
+// Nodes without a translation are evaluated by the tree walker.
+void Compiler::evaluate(AbstractNode *node, unsigned target) {
+    chunk->nodes.push_back(node);
+    emit(OP_EVALUATE, target, (unsigned) chunk->nodes.size() - 1);
+}
+
+void Compiler::beginLoop() {
+    loops.push_back(vector<unsigned>());
+}
+
+void Compiler::endLoop() {
+    for (auto const &jump : loops.back()) {
+        patch(jump);
+    }
+    loops.pop_back();
+}
+
+bool Compiler::breakLoop() {
+    if (loops.empty()) {
+        return false;
+    }
+    loops.back().push_back(jump(OP_JUMP));
+    return true;
+}
+
+// Temporaries are numbered after the constants once their count is known.
+void Compiler::finish(unsigned result) {
+    emit(OP_RETURN, result);
+
+    unsigned constants = (unsigned) chunk->constants.size();
+    chunk->registerCount = narrow(constants + temporaries);
+
+    for (auto const &pending : code) {
+        unsigned operands = registerOperands(pending.opcode);
+        Instruction instruction;
+        instruction.opcode = (uint8_t) pending.opcode;
+        instruction.a = operands & 1 ? resolve(pending.a) : narrow(pending.a);
+        instruction.b = operands & 2 ? resolve(pending.b) : narrow(pending.b);
+        instruction.c = operands & 4 ? resolve(pending.c) : narrow(pending.c);
+        chunk->code.push_back(instruction);
+    }
+}
+
+uint16_t Compiler::resolve(unsigned operand) {
+    if (operand & ConstantOperand) {
+        return narrow(operand & ~ConstantOperand);
+    }
+    return narrow(operand + (unsigned) chunk->constants.size());
+}
+
+uint16_t Compiler::narrow(unsigned operand) {
+    if (operand > 0xffff) {
+        tooLarge = true;
+    }
+    return (uint16_t) operand;
+}
+
+// Operands that are registers, bit 0 for a, bit 1 for b and bit 2 for c.
+unsigned Compiler::registerOperands(Opcode opcode) {
+    switch (opcode) {
+        case OP_LOAD_VARIABLE:
+        case OP_PRINT:
+        case OP_PRINTLN:
+        case OP_SCAN_INT:
+        case OP_SCAN_CHAR:
+        case OP_SCAN_STRING:
+        case OP_JUMP_IF_FALSE:
+        case OP_EVALUATE:
+        case OP_RETURN:
+            return 1;
+        case OP_STORE_VARIABLE:
+            return 2;
+        case OP_MOVE:
+        case OP_NOT:
+        case OP_LEN:
+        case OP_APPEND:
+            return 3;
+        case OP_JUMP:
+        case OP_SAFEPOINT:
+            return 0;
+        default:
+            return 7;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+unsigned NodeBlock::compile(Compiler *compiler) {
+    unsigned last = compiler->null();
+    for (auto const &node : *nodes) {
+        unsigned mark = compiler->mark();
+        compiler->emit(OP_SAFEPOINT);
+        last = node->compile(compiler);
+        compiler->release(mark);
+    }
+    return last;
+}
+
+unsigned NodeVariableDefinition::compile(Compiler *compiler) {
+    unsigned evaluated = value->compile(compiler);
+    compiler->emit(OP_STORE_VARIABLE, slot, evaluated, 0, &location);
+    return compiler->null();
+}
+
+unsigned NodeVariableName::compile(Compiler *compiler) {
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_LOAD_VARIABLE, target, slot);
+    return target;
+}
+
+unsigned NodePrint::compile(Compiler *compiler) {
+    unsigned evaluated = value->compile(compiler);
+    compiler->emit(breakLine ? OP_PRINTLN : OP_PRINT, evaluated);
+    return compiler->null();
+}
+
+unsigned NodeBinaryOperator::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned t1 = a->compile(compiler);
+    unsigned t2 = b->compile(compiler);
+    compiler->release(mark);
+
+    unsigned target = compiler->temporary();
+    compiler->emit((Opcode) (OP_ADD + op), target, t1, t2, &location);
+    return target;
+}
+
+unsigned NodeNotOperator::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned t = a->compile(compiler);
+    compiler->release(mark);
+
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_NOT, target, t);
+    return target;
+}
+
+unsigned NodeConstant::compile(Compiler *compiler) {
+    return compiler->constant(value);
+}
+
+unsigned NodeWhile::compile(Compiler *compiler) {
+    unsigned start = compiler->here();
+    compiler->emit(OP_SAFEPOINT);
+
+    unsigned mark = compiler->mark();
+    unsigned evaluated = condition->compile(compiler);
+    compiler->release(mark);
+    unsigned exit = compiler->jump(OP_JUMP_IF_FALSE, evaluated);
+
+    compiler->beginLoop();
+    block->compile(compiler);
+    compiler->jumpTo(start);
+    compiler->patch(exit);
+    compiler->endLoop();
+    return compiler->null();
+}
+
+unsigned NodeIfElse::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned evaluated = condition->compile(compiler);
+    compiler->release(mark);
+    unsigned toElse = compiler->jump(OP_JUMP_IF_FALSE, evaluated);
+
+    ifBlock->compile(compiler);
+    unsigned toEnd = compiler->jump(OP_JUMP);
+    compiler->patch(toElse);
+    elseBlock->compile(compiler);
+    compiler->patch(toEnd);
+    return compiler->null();
+}
+
+unsigned NodeScanInt::compile(Compiler *compiler) {
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_SCAN_INT, target);
+    return target;
+}
+
+unsigned NodeScanChar::compile(Compiler *compiler) {
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_SCAN_CHAR, target);
+    return target;
+}
+
+unsigned NodeScanString::compile(Compiler *compiler) {
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_SCAN_STRING, target, 0, 0, &location);
+    return target;
+}
+
+// A break outside of any loop is left to the tree walker, so that it fails the same way.
+unsigned NodeBreak::compile(Compiler *compiler) {
+    if (!compiler->breakLoop()) {
+        compiler->evaluate(this, compiler->temporary());
+    }
+    return compiler->null();
+}
+
+unsigned NodeLen::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned list = expression->compile(compiler);
+    compiler->release(mark);
+
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_LEN, target, list);
+    return target;
+}
+
+unsigned NodeAppend::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned list = compiler->temporary(listExpression);
+    unsigned value = compiler->temporary(valueExpression);
+    compiler->emit(OP_APPEND, list, value, 0, &location);
+    compiler->release(mark);
+    return compiler->null();
+}
+
+unsigned NodeGet::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned list = listExpression->compile(compiler);
+    unsigned index = indexExpression->compile(compiler);
+    compiler->release(mark);
+
+    unsigned target = compiler->temporary();
+    compiler->emit(OP_GET, target, list, index);
+    return target;
+}
+
+unsigned NodeSet::compile(Compiler *compiler) {
+    unsigned mark = compiler->mark();
+    unsigned list = compiler->temporary(listExpression);
+    unsigned index = indexExpression->compile(compiler);
+    unsigned value = compiler->temporary(valueExpression);
+    compiler->emit(OP_SET, list, index, value, &location);
+    compiler->release(mark);
+    return compiler->null();
+}
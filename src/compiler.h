@@ -0,0 +1,111 @@
+#ifndef TEETON_COMPILER_H
+#define TEETON_COMPILER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "type.h"
+
+class AbstractNode;
+
+// Binary operators are in the order of Operator, so OP_ADD + op is the opcode of op. A comparison
+// followed by OP_JUMP_IF_FALSE becomes a test, which takes the jump after it when the comparison is false.
+enum Opcode {
+    OP_MOVE, OP_LOAD_VARIABLE, OP_STORE_VARIABLE,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_EQ, OP_NEQ, OP_EQEQ, OP_GT, OP_LT, OP_GTE, OP_LTE, OP_AND, OP_OR,
+    OP_NOT, OP_LEN, OP_APPEND, OP_GET, OP_SET,
+    OP_PRINT, OP_PRINTLN, OP_SCAN_INT, OP_SCAN_CHAR, OP_SCAN_STRING,
+    OP_JUMP, OP_JUMP_IF_FALSE, OP_TEST_EQ, OP_TEST_NEQ, OP_TEST_GT, OP_TEST_LT, OP_TEST_GTE, OP_TEST_LTE,
+    OP_SAFEPOINT, OP_EVALUATE, OP_RETURN,
+    OPCODE_COUNT
+};
+
+// Operands are registers of the chunk, variable slots or indexes into the chunk. Jumps keep their
+// target in b and c.
+struct Instruction {
+    uint8_t opcode;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+
+    unsigned target() const { return b | (unsigned) c << 16; };
+};
+
+// Compiled program. The first registers hold the constants, the rest are temporaries of expressions.
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<SourceLocation *> sites;  // location of the node of every instruction that allocates
+    std::vector<Value> constants;
+    std::vector<AbstractNode *> nodes;  // nodes left to the tree walker, see OP_EVALUATE
+    unsigned registerCount = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+// Translates the tree into register bytecode. Every node compiles itself and returns the register
+// that holds its value, statements return the register of null.
+class Compiler {
+public:
+    // false when the program has more registers or instructions than operands can address
+    static bool compile(AbstractNode *root, Chunk *chunk);
+
+    unsigned constant(Value value);
+
+    unsigned null() { return nullRegister; };
+
+    unsigned temporary();
+
+    unsigned temporary(AbstractNode *node);
+
+    unsigned mark() { return top; };
+
+    void release(unsigned mark) { top = mark; };
+
+    void emit(Opcode opcode, unsigned a = 0, unsigned b = 0, unsigned c = 0, SourceLocation *site = nullptr);
+
+    unsigned jump(Opcode opcode, unsigned condition = 0);
+
+    void jumpTo(unsigned target);
+
+    void patch(unsigned jump);
+
+    unsigned here() { return (unsigned) code.size(); };
+
+    void evaluate(AbstractNode *node, unsigned target);
+
+    void beginLoop();
+
+    void endLoop();
+
+    bool breakLoop();
+
+private:
+    struct Pending {
+        Opcode opcode;
+        unsigned a;
+        unsigned b;
+        unsigned c;
+    };
+
+    Compiler(Chunk *chunk);
+
+    void finish(unsigned result);
+
+    uint16_t resolve(unsigned operand);
+
+    uint16_t narrow(unsigned operand);
+
+    static unsigned registerOperands(Opcode opcode);
+
+    static const unsigned ConstantOperand = 0x80000000;
+
+    Chunk *chunk;
+    std::vector<Pending> code;
+    std::vector<std::vector<unsigned>> loops;  // jumps of the breaks of every loop being compiled
+    unsigned nullRegister;
+    unsigned top = 0;
+    unsigned temporaries = 0;
+    bool tooLarge = false;
+};
+
+#endif //TEETON_COMPILER_H
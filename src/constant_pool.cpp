@@ -0,0 +1,51 @@
+#include "constant_pool.h"
+
+using namespace std;
+
+ConstantPool::~ConstantPool() {
+    for (auto const &list : lists) {
+        delete list;
+    }
+
+    for (auto const &it : strings) {
+        if (--it.second->references == 0) {
+            delete it.second;
+        }
+    }
+}
+
+Value ConstantPool::addBool(bool value) {
+    return Value::fromBool(value, nextIdentity());
+}
+
+Value ConstantPool::addChar(char value) {
+    return Value::fromChar(value, nextIdentity());
+}
+
+Value ConstantPool::addInt(int value) {
+    return Value::fromInt(value, nextIdentity());
+}
+
+Value ConstantPool::addString(string value) {
+    ListStorage *storage;
+
+    auto it = strings.find(value);
+    if (it != strings.end()) {
+        storage = it->second;
+    } else {
+        storage = new ListStorage(STRING_LIST);
+        for (char &c : value) {
+            storage->append(addChar(c));
+        }
+        strings[value] = storage;
+    }
+
+    storage->references++;
+    TypeList *list = new TypeList(storage, (unsigned) value.size(), true);
+    lists.push_back(list);
+    return Value::fromList(list);
+}
+
+unsigned ConstantPool::nextIdentity() {
+    return Value::ConstantIdentity | (identity++ & Value::RuntimeIdentityMask);
+}
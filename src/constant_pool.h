@@ -0,0 +1,32 @@
+#ifndef TEETON_CONSTANT_POOL_H
+#define TEETON_CONSTANT_POOL_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "type.h"
+
+// Literals of a program hoisted by the parser. Scalars are shared values, string and list literals
+// are constant lists which live outside of the garbage collected heap and are materialized on first store.
+class ConstantPool {
+public:
+    ~ConstantPool();
+
+    Value addBool(bool value);
+
+    Value addChar(char value);
+
+    Value addInt(int value);
+
+    Value addString(std::string value);
+
+private:
+    unsigned nextIdentity();
+
+    unsigned identity = 0;
+    std::vector<TypeList *> lists;
+    std::unordered_map<std::string, ListStorage *> strings;
+};
+
+#endif //TEETON_CONSTANT_POOL_H
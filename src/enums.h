@@ -13,4 +13,34 @@ enum Type {
     CHAR, BOOL, INT, LIST
 };
 
+enum ListKind {
+    GENERIC_LIST,  // boxed values
+    STRING_LIST,  // packed chars
+    INT_LIST,  // unboxed ints
+    LIST_KIND_COUNT
+};
+
+// How the evaluation of a node ended. Break and runtime errors are not thrown, the node returns early
+// and its parents pass the completion on until a loop or the program handles it.
+enum Completion {
+    NORMAL_COMPLETION,
+    BREAK_COMPLETION,  // the innermost loop ends
+    ERROR_COMPLETION  // the program ends with the error
+};
+
+// How the parent of a node uses its value, see Optimizer. Results of operators have identities of their
+// own, so an operator whose identity is used stays even when its operands are constants.
+enum ValueUse {
+    VALUE_DISCARDED,  // statements, except the last one of the program which the console prints
+    VALUE_USED,  // operands, conditions, arguments and printed values
+    IDENTITY_USED  // stored into a variable or a list, or compared by ===
+};
+
+enum GcTrigger {
+    NURSERY_FULL,  // allocation found no room in the nursery
+    HEAP_THRESHOLD,  // the heap grew over the threshold of the next collection
+    HEAP_LIMIT,  // the heap grew over the hard limit
+    GC_TRIGGER_COUNT
+};
+
 #endif //TEETON_ENUMS_H
@@ -1,100 +1,325 @@
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 
 #include "environment.h"
+#include "heap_snapshot.h"
 
 using namespace std;
+using namespace std::chrono;
+
+volatile sig_atomic_t Environment::snapshotRequested = 0;
+
+Environment::Environment(SymbolTable *symbols, HeapOptions options)
+        : initialHeapSize(options.initialHeapSize), maxHeapSize(options.maxHeapSize),
+          heapThreshold(options.initialHeapSize), collectionTrigger(options.initialHeapSize),
+          pauseBudget(options.pauseBudget), snapshotFile(options.snapshotFile), symbols(symbols), lists(sizeof(TypeList)), marker(options.markThreads) {
+    nursery = (char *) operator new(SlotSize * options.nurserySize);
+    nurseryTop = nursery;
+    nurseryEnd = nursery + SlotSize * options.nurserySize;
+    forwarding.resize(options.nurserySize, nullptr);
+}
 
 Environment::~Environment() {
-    for (auto const &value : heap) {
-        delete value;
+    for (char *slot = nursery; slot < nurseryTop; slot += SlotSize) {
+        ((TypeList *) slot)->~TypeList();
     }
+    operator delete(nursery);
 }
 
-void Environment::setVariable(string name, AbstractType *value) {
-    variables[name] = value;
-}
+// Lists and variables without a slot yet. All variables are scanned by every minor collection,
+// so they need no write barrier for young lists.
+void Environment::storeVariable(unsigned slot, Value value) {
+    value = materialize(value);
+    if (abrupt()) {
+        return;
+    }
 
-AbstractType *Environment::getVariable(string name) {
-    if (variables.find(name) == variables.end()) {
-        ostringstream os;
-        os << "Undefined variable " << name << ".";
-        runtimeError(os.str());
+    if (slot >= variables.size()) {
+        variables.resize(symbols->size());
+        defined.resize(symbols->size(), false);
     }
+    variables[slot] = value;
+    defined[slot] = true;
 
-    return variables[name];
+    if (marking) {
+        shade(value);
+    }
 }
 
-TypeBool *Environment::allocBool(bool value) {
-    checkHeap();
-    TypeBool *newBool = new TypeBool(value);
-    heap.push_back(newBool);
-    return newBool;
+Value Environment::undefinedVariable(unsigned slot) {
+    ostringstream os;
+    os << "Undefined variable " << symbols->name(slot) << ".";
+    return fail(os.str());
 }
 
-TypeChar *Environment::allocChar(char value) {
-    checkHeap();
-    TypeChar *newChar = new TypeChar(value);
-    heap.push_back(newChar);
-    return newChar;
+// Values made after the error are never compared, the program ends at the next check of the completion.
+unsigned Environment::outOfIdentities() {
+    fail("Out of identities");
+    return 0;
 }
 
-TypeInt *Environment::allocInt(int value) {
-    checkHeap();
-    TypeInt *newInt = new TypeInt(value);
-    heap.push_back(newInt);
-    return newInt;
+Value Environment::fail(const string &message) {
+    if (completion != ERROR_COMPLETION) {
+        completion = ERROR_COMPLETION;
+        error = "RuntimeError: " + message;
+    }
+    return Value();
 }
 
-TypeList *Environment::allocList(std::vector<AbstractType *> *value) {
-    checkHeap();
-    TypeList *newList = new TypeList(value);
-    heap.push_back(newList);
+TypeList *Environment::allocList(ListStorage *storage) {
+    return allocList(storage, storage->size());
+}
+
+// Allocation is a collection point. The storage of the new list is not reachable from anywhere yet,
+// so the collection treats it as a root.
+TypeList *Environment::allocList(ListStorage *storage, unsigned length) {
+    if (nurseryTop == nurseryEnd || heapBytes() >= collectionTrigger) {
+        collect(storage, nurseryTop == nurseryEnd ? NURSERY_FULL : HEAP_THRESHOLD);
+    }
+
+    stats.allocatedLists++;
+    stats.allocatedBytes += SlotSize;
+
+    TypeList *newList = new(nurseryTop) TypeList(storage, length);
+    newList->site = site;
+    nurseryTop += SlotSize;
     return newList;
 }
 
-void Environment::checkHeap() {
-    if (heap.size() >= heapSizeLimit) {
-        markAndSweep();
+void Environment::writeSnapshot(string file) {
+    ofstream os(file);
+    HeapSnapshot::write(this, os);
+}
+
+// Snapshots requested while the program runs are numbered, FILE.1, FILE.2, ...
+void Environment::writeRequestedSnapshot() {
+    snapshotRequested = 0;
+    if (!snapshotFile.empty()) {
+        writeSnapshot(snapshotFile + "." + to_string(++snapshots));
+    }
+}
+
+ListStorage *Environment::makeString(const string &chars) {
+    ListStorage *storage = new ListStorage(STRING_LIST);
+    for (char c : chars) {
+        storage->append(makeChar(c));
+    }
+    return storage;
+}
+
+Value Environment::materialize(Value value) {
+    if (value.isList() && value.listValue()->isConstant()) {
+        TypeList *constant = value.listValue();
+        return Value::fromList(allocList(constant->share(), constant->size()));
+    }
+    return value;
+}
+
+// Old-to-young pointers are remembered by slot, so a minor collection does not rescan whole lists.
+// Besides that the barrier keeps the marking invariant - a list already scanned by the marker never
+// points to an unmarked list.
+void Environment::writeBarrier(TypeList *list, unsigned index, Value value) {
+    if (!isYoung(Value::fromList(list)) && isYoung(value)) {
+        rememberedSlots.push_back({list, index});
+    }
+    if (marking) {
+        shade(value);
     }
+}
 
-    if (heap.size() >= heapSizeLimit) {
-        runtimeError("Out of memory");
+bool Environment::isYoung(Value value) {
+    if (!value.isList()) {
+        return false;
     }
+    char *address = (char *) value.listValue();
+    return address >= nursery && address < nurseryEnd;
 }
 
-void Environment::markAndSweep() {
-    markFalse();
+// Young lists are not traced by the marker, so every step starts with a minor collection which
+// promotes the survivors into the old generation as gray lists. Once marking is complete the program
+// continues right away and the slabs are swept in the following steps.
+void Environment::collect(ListStorage *pending, GcTrigger trigger) {
+    steady_clock::time_point start = steady_clock::now();
+    stats.collections[trigger]++;
+    minorCollection(pending);
+    stats.minorCollections++;
+    stats.minorTime += GcStats::milliseconds(steady_clock::now() - start);
+
+    // above the hard limit the collection is finished at once, it may be the last chance to free memory
+    steady_clock::time_point deadline = heapBytes() > maxHeapSize ? steady_clock::time_point::max()
+                                                                  : start + pauseBudget;
+    if (sweeping) {
+        sweep(deadline);
+    }
 
-    for (auto it : variables) {
-        mark(it.second);
+    if (!sweeping && !marking && heapBytes() >= heapThreshold) {
+        startMarking(heapBytes() > maxHeapSize ? HEAP_LIMIT : HEAP_THRESHOLD);
     }
 
-    sweep();
+    if (marking && pending != nullptr && pending->kind == GENERIC_LIST) {
+        for (unsigned i = 0; i < pending->size(); i++) {
+            shade(pending->items()[i]);
+        }
+    }
+
+    if (marking && markStep(deadline)) {
+        marking = false;
+        sweeping = true;
+        lists.startSweep();
+        if (deadline == steady_clock::time_point::max()) {
+            sweep(deadline);
+        }
+    }
+
+    collectionTrigger = marking || sweeping ? heapBytes() + StepBytes : heapThreshold;
+    stats.pauses.record(steady_clock::now() - start);
 }
 
-void Environment::markFalse() {
-    for (auto const &value : heap) {
-        value->marked = false;
+// The next collection is scheduled relative to the live data - the more of the heap survived,
+// the more room is given so that a mostly live heap is not collected over and over again.
+void Environment::resizeHeap() {
+    size_t live = heapBytes();
+
+    if (live > maxHeapSize) {
+        fail("Out of memory");
     }
+
+    double liveRatio = (double) live / heapThreshold;
+    size_t factor = liveRatio > 0.5 ? 3 : 2;
+    heapThreshold = max(initialHeapSize, min(maxHeapSize, live * factor));
 }
 
-void Environment::mark(AbstractType *variable) {
-    variable->marked = true;
+void Environment::minorCollection(ListStorage *pending) {
+    for (auto &variable : variables) {
+        evacuate(&variable);
+    }
+
+    for (auto const &root : roots) {
+        evacuate(root);
+    }
+
+    if (pending != nullptr && pending->kind == GENERIC_LIST) {
+        for (unsigned i = 0; i < pending->size(); i++) {
+            evacuate(&pending->items()[i]);
+        }
+    }
+
+    for (auto const &slot : rememberedSlots) {
+        Value *references = slot.list->references();
+        if (references != nullptr && slot.index < slot.list->size()) {
+            evacuate(&references[slot.index]);
+        }
+    }
+
+    while (!promoted.empty()) {
+        TypeList *list = promoted.back();
+        promoted.pop_back();
+        scan(list);
+    }
 
-    if (variable->type() == LIST) {
-        TypeList *list = (TypeList *) variable;
-        for (auto const &item : *list->value()) {
-            mark(item);
+    for (char *slot = nursery; slot < nurseryTop; slot += SlotSize) {
+        unsigned index = (unsigned) ((slot - nursery) / SlotSize);
+        if (forwarding[index] == nullptr) {
+            ((TypeList *) slot)->~TypeList();
         }
+        forwarding[index] = nullptr;
     }
+
+    nurseryTop = nursery;
+    rememberedSlots.clear();
 }
 
-void Environment::sweep() {
-    for (vector<AbstractType *>::iterator it = heap.end() - 1; it != heap.begin() - 1; it--) {
-        if (!(*it)->marked) {
-            delete *it;
-            it = heap.erase(it);
+void Environment::evacuate(Value *slot) {
+    if (!isYoung(*slot)) {
+        return;
+    }
+
+    TypeList *list = slot->listValue();
+    unsigned index = (unsigned) (((char *) list - nursery) / SlotSize);
+
+    if (forwarding[index] == nullptr) {
+        TypeList *survivor = new(lists.allocate()) TypeList(*list);
+        forwarding[index] = survivor;
+        promoted.push_back(survivor);
+        stats.promotedLists++;
+        if (marking) {
+            shade(survivor);
         }
     }
+
+    *slot = Value::fromList(forwarding[index]);
+}
+
+void Environment::scan(TypeList *list) {
+    Value *references = list->references();
+    if (references == nullptr) {
+        return;
+    }
+
+    for (unsigned i = 0; i < list->size(); i++) {
+        evacuate(&references[i]);
+    }
+}
+
+void Environment::startMarking(GcTrigger trigger) {
+    GcCycle cycle;
+    cycle.trigger = trigger;
+    cycle.objectsBefore = lists.size();
+    cycle.bytesBefore = heapBytes();
+    stats.cycles.push_back(cycle);
+
+    marking = true;
+    for (auto const &variable : variables) {
+        shade(variable);
+    }
+    for (auto const &root : roots) {
+        shade(*root);
+    }
+}
+
+bool Environment::markStep(steady_clock::time_point deadline) {
+    steady_clock::time_point start = steady_clock::now();
+    bool complete = marker.mark(deadline);
+    stats.cycles.back().markTime += GcStats::milliseconds(steady_clock::now() - start);
+    stats.cycles.back().markSteps++;
+    return complete;
+}
+
+// Constant lists live outside of the heap and are never marked.
+void Environment::shade(Value value) {
+    if (value.isList() && !isYoung(value) && !value.listValue()->isConstant()) {
+        shade(value.listValue());
+    }
 }
 
+void Environment::shade(TypeList *list) {
+    marker.shade(list);
+}
+
+// -----------------------------------------------------------------------------
+
+// The heap is resized once all slabs are swept, before that the heap still counts the garbage.
+void Environment::sweep(steady_clock::time_point deadline) {
+    steady_clock::time_point start = steady_clock::now();
+    bool complete = lists.sweep(deadline);
+    stats.cycles.back().sweepTime += GcStats::milliseconds(steady_clock::now() - start);
+    stats.cycles.back().sweepSteps++;
+
+    if (complete) {
+        sweeping = false;
+        stats.cycles.back().finished = true;
+        stats.cycles.back().objectsAfter = lists.size();
+        stats.cycles.back().bytesAfter = heapBytes();
+        resizeHeap();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+Root::Root(Environment *env, Value value) : value(value), env(env) {
+    env->roots.push_back(&this->value);
+    if (env->marking) {
+        env->shade(value);
+    }
+}
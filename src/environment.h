@@ -1,44 +1,203 @@
 #ifndef TEETON_ENVIRONMENT_H
 #define TEETON_ENVIRONMENT_H
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <string>
-#include <unordered_map>
 
+#include "gc_stats.h"
+#include "jit.h"
+#include "marker.h"
+#include "slab.h"
+#include "symbol_table.h"
 #include "utils.h"
 #include "type.h"
 
+// Settings of the heap, sizes are in bytes and the pause budget in microseconds.
+struct HeapOptions {
+    size_t initialHeapSize = 1024 * 1024;
+    size_t maxHeapSize = 1024 * 1024 * 1024;
+    unsigned nurserySize = 1024;
+    unsigned pauseBudget = 1000;
+    unsigned markThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+    std::string snapshotFile;
+};
+
+// -----------------------------------------------------------------------------
+
 class Environment {
 public:
-    Environment(int heapSizeLimit = 2048) : heapSizeLimit(heapSizeLimit) {};
+    Environment(SymbolTable *symbols, HeapOptions options = HeapOptions());
 
     ~Environment();
 
-    void setVariable(std::string name, AbstractType *value);
+    void setVariable(unsigned slot, Value value) {
+        if (value.isList() || slot >= variables.size()) {
+            storeVariable(slot, value);
+        } else {
+            variables[slot] = value;
+            defined[slot] = true;
+        }
+    };
+
+    Value getVariable(unsigned slot) {
+        if (slot >= variables.size() || !defined[slot]) return undefinedVariable(slot);
+        return variables[slot];
+    };
+
+    bool isDefined(unsigned slot) { return slot < variables.size() && defined[slot]; };
+
+    // records the runtime error unless another one is already pending, returns null for the node to return
+    Value fail(const std::string &message);
+
+    bool abrupt() { return completion != NORMAL_COMPLETION; };
+
+    Value makeBool(bool value) { return Value::fromBool(value, nextIdentity()); };
+
+    Value makeChar(char value) { return Value::fromChar(value, nextIdentity()); };
+
+    Value makeInt(int value) { return Value::fromInt(value, nextIdentity()); };
+
+    // every char gets an identity of its own like from makeChar
+    ListStorage *makeString(const std::string &chars);
+
+    TypeList *allocList(ListStorage *storage);
 
-    AbstractType *getVariable(std::string name);
+    TypeList *allocList(ListStorage *storage, unsigned length);
 
-    TypeBool *allocBool(bool value);
+    Value materialize(Value value);
 
-    TypeChar *allocChar(char value);
+    void writeBarrier(TypeList *list, unsigned index, Value value);
 
-    TypeInt *allocInt(int value);
+    // false when the collection ran out of memory
+    bool safepoint() {
+        if (snapshotRequested) {
+            writeRequestedSnapshot();
+        }
+        if (heapBytes() < collectionTrigger) {
+            return true;
+        }
+        collect(nullptr, HEAP_THRESHOLD);
+        return !abrupt();
+    };
 
-    TypeList *allocList(std::vector<AbstractType *> *value);
+    void writeSnapshot(std::string file);
+
+    size_t heapBytes() { return lists.bytes() + ListStorage::allocatedBytes; };
+
+    GcStats stats;
+
+    // location of the node being evaluated, recorded in allocated lists
+    SourceLocation *site = nullptr;
+
+    // compiles hot loops of the tree walker when it is set
+    Jit *jit = nullptr;
+
+    // completion of the node evaluated last, the message of the error for ERROR_COMPLETION
+    Completion completion = NORMAL_COMPLETION;
+    std::string error;
+
+    static volatile std::sig_atomic_t snapshotRequested;
 
 private:
-    unsigned heapSizeLimit;
-    std::unordered_map<std::string, AbstractType *> variables;
-    std::vector<AbstractType *> heap;
+    size_t initialHeapSize;
+    size_t maxHeapSize;
+    size_t heapThreshold;
+    size_t collectionTrigger;
+    std::chrono::microseconds pauseBudget;
+    std::string snapshotFile;
+    unsigned snapshots = 0;
+    unsigned identity = 1;
+    SymbolTable *symbols;
+    std::vector<Value> variables;
+    std::vector<char> defined;
+    SlabAllocator lists;
+
+    // young generation - lists are bump allocated into fixed size slots and evacuated by minor collections
+    char *nursery;
+    char *nurseryTop;
+    char *nurseryEnd;
+    std::vector<TypeList *> forwarding;
+    std::vector<TypeList *> promoted;
+    std::vector<ListSlot> rememberedSlots;
+
+    // values held by the interpreter while an expression is evaluated, see Root
+    std::vector<Value *> roots;
+
+    // old generation - marked and swept incrementally in steps
+    Marker marker;
+    bool marking = false;
+    bool sweeping = false;
+
+    static const size_t StepBytes = 64 * 1024;
+    static const size_t SlotSize = (sizeof(TypeList) + 7) & ~((size_t) 7);
+
+    void storeVariable(unsigned slot, Value value);
+
+    Value undefinedVariable(unsigned slot);
 
-    void checkHeap();
+    // identities are never reused, the program fails once they run out
+    unsigned nextIdentity() {
+        if (identity > Value::RuntimeIdentityMask) {
+            return outOfIdentities();
+        }
+        return identity++;
+    };
 
-    void markAndSweep();
+    unsigned outOfIdentities();
 
-    void markFalse();
+    bool isYoung(Value value);
+
+    void writeRequestedSnapshot();
+
+    void collect(ListStorage *pending, GcTrigger trigger);
+
+    void minorCollection(ListStorage *pending);
+
+    void evacuate(Value *slot);
+
+    void scan(TypeList *list);
+
+    void startMarking(GcTrigger trigger);
+
+    bool markStep(std::chrono::steady_clock::time_point deadline);
+
+    void shade(Value value);
+
+    void shade(TypeList *list);
+
+    void resizeHeap();
+
+    void sweep(std::chrono::steady_clock::time_point deadline);
+
+    friend class Root;
+
+    friend class Vm;
+
+    friend class Jit;
+
+    friend class HeapSnapshot;
+};
+
+// -----------------------------------------------------------------------------
+
+// Value held by C++ code across an allocation. A collection may run at any allocation, it keeps
+// the rooted value alive and updates it when the list is moved out of the nursery.
+class Root {
+public:
+    Root(Environment *env, Value value);
+
+    ~Root() { env->roots.pop_back(); };
+
+    Value value;
+
+private:
+    Root(const Root &) = delete;
 
-    void mark(AbstractType *value);
+    Root &operator=(const Root &) = delete;
 
-    void sweep();
+    Environment *env;
 };
 
 #endif //TEETON_ENVIRONMENT_H
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "gc_stats.h"
+#include "type.h"
+
+using namespace std;
+using namespace std::chrono;
+
+void PauseHistogram::record(steady_clock::duration pause) {
+    double micros = duration<double, micro>(pause).count();
+    unsigned bucket = 0;
+    while (bucket < Buckets - 1 && micros >= (double) (1u << bucket)) {
+        bucket++;
+    }
+
+    counts[bucket]++;
+    pauses++;
+    total += micros;
+    longest = max(longest, micros);
+}
+
+void PauseHistogram::printText(ostream &os) {
+    os << "pauses: " << pauses << ", total " << total / 1000 << " ms, max " << longest / 1000 << " ms" << endl;
+    for (unsigned i = 0; i < Buckets; i++) {
+        if (counts[i] > 0) {
+            os << "  < " << setw(8) << (1u << i) << " us: " << counts[i] << endl;
+        }
+    }
+}
+
+void PauseHistogram::printJson(ostream &os) {
+    os << "{\"count\": " << pauses << ", \"total_ms\": " << total / 1000 << ", \"max_ms\": " << longest / 1000
+    << ", \"histogram\": [";
+    bool first = true;
+    for (unsigned i = 0; i < Buckets; i++) {
+        if (counts[i] > 0) {
+            os << (first ? "" : ", ") << "{\"below_us\": " << (1u << i) << ", \"count\": " << counts[i] << "}";
+            first = false;
+        }
+    }
+    os << "]}";
+}
+
+// -----------------------------------------------------------------------------
+
+double GcStats::milliseconds(steady_clock::duration time) {
+    return duration<double, milli>(time).count();
+}
+
+// The format of the stream is restored, it is usually standard error.
+void GcStats::printText(ostream &os) {
+    double runtime = milliseconds(steady_clock::now() - start) / 1000;
+    ios::fmtflags flags = os.flags();
+    streamsize precision = os.precision(3);
+    os << fixed;
+    os << "gc: " << cycles.size() << " cycles, " << minorCollections << " minor collections in "
+    << runtime << " s" << endl;
+
+    if (!cycles.empty()) {
+        os << "cycle  trigger          objects before -> after        bytes before -> after   "
+        "mark ms (steps)  sweep ms (steps)" << endl;
+    }
+    for (unsigned i = 0; i < cycles.size(); i++) {
+        GcCycle &cycle = cycles[i];
+        os << setw(5) << i + 1 << "  " << left << setw(15) << name(cycle.trigger) << right
+        << setw(10) << cycle.objectsBefore << " -> " << left << setw(10) << after(cycle, cycle.objectsAfter) << right
+        << setw(12) << cycle.bytesBefore << " -> " << left << setw(10) << after(cycle, cycle.bytesAfter) << right
+        << setw(9) << cycle.markTime << " (" << setw(4) << cycle.markSteps << ")"
+        << setw(10) << cycle.sweepTime << " (" << setw(4) << cycle.sweepSteps << ")" << endl;
+    }
+
+    os << "minor collections: " << minorCollections << ", " << minorTime << " ms, "
+    << promotedLists << " lists promoted" << endl;
+
+    os << "collections by trigger:";
+    for (int trigger = 0; trigger < GC_TRIGGER_COUNT; trigger++) {
+        os << " " << name((GcTrigger) trigger) << " " << collections[trigger];
+    }
+    os << endl;
+
+    os << "allocation: " << allocatedLists << " lists, " << rate(allocatedBytes, runtime) << endl;
+    for (int kind = 0; kind < LIST_KIND_COUNT; kind++) {
+        os << "  " << left << setw(8) << name((ListKind) kind) << right << " storage "
+        << rate(ListStorage::grownBytes[kind], runtime) << endl;
+    }
+
+    pauses.printText(os);
+    os.flags(flags);
+    os.precision(precision);
+}
+
+// The format of the stream is restored, it is usually standard error.
+void GcStats::printJson(ostream &os) {
+    double runtime = milliseconds(steady_clock::now() - start) / 1000;
+    ios::fmtflags flags = os.flags();
+    streamsize precision = os.precision(3);
+    os << fixed;
+    os << "{\"runtime_s\": " << runtime << ", \"cycles\": [";
+    for (unsigned i = 0; i < cycles.size(); i++) {
+        GcCycle &cycle = cycles[i];
+        os << (i > 0 ? ", " : "") << "{\"trigger\": \"" << name(cycle.trigger) << "\""
+        << ", \"finished\": " << (cycle.finished ? "true" : "false")
+        << ", \"objects_before\": " << cycle.objectsBefore << ", \"bytes_before\": " << cycle.bytesBefore;
+        if (cycle.finished) {
+            os << ", \"objects_after\": " << cycle.objectsAfter << ", \"bytes_after\": " << cycle.bytesAfter;
+        }
+        os << ", \"mark_ms\": " << cycle.markTime << ", \"mark_steps\": " << cycle.markSteps
+        << ", \"sweep_ms\": " << cycle.sweepTime << ", \"sweep_steps\": " << cycle.sweepSteps << "}";
+    }
+
+    os << "], \"minor\": {\"count\": " << minorCollections << ", \"time_ms\": " << minorTime
+    << ", \"promoted\": " << promotedLists << "}, \"collections\": {";
+    for (int trigger = 0; trigger < GC_TRIGGER_COUNT; trigger++) {
+        os << (trigger > 0 ? ", " : "") << "\"" << name((GcTrigger) trigger) << "\": " << collections[trigger];
+    }
+
+    os << "}, \"allocation\": {\"lists\": " << allocatedLists << ", \"list_bytes\": " << allocatedBytes
+    << ", \"storage\": {";
+    for (int kind = 0; kind < LIST_KIND_COUNT; kind++) {
+        size_t bytes = ListStorage::grownBytes[kind];
+        os << (kind > 0 ? ", " : "") << "\"" << name((ListKind) kind) << "\": {\"bytes\": " << bytes
+        << ", \"bytes_per_s\": " << (runtime > 0 ? bytes / runtime : 0) << "}";
+    }
+
+    os << "}}, \"pauses\": ";
+    pauses.printJson(os);
+    os << "}" << endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+// A cycle still running at exit has not freed anything yet.
+string GcStats::after(GcCycle &cycle, size_t size) {
+    return cycle.finished ? to_string(size) : "unfinished";
+}
+
+string GcStats::rate(size_t bytes, double seconds) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    ostringstream os;
+    os << fixed << setprecision(3) << megabytes << " MB, " << (seconds > 0 ? megabytes / seconds : 0) << " MB/s";
+    return os.str();
+}
+
+const char *GcStats::name(GcTrigger trigger) {
+    switch (trigger) {
+        case NURSERY_FULL:
+            return "nursery-full";
+        case HEAP_THRESHOLD:
+            return "heap-threshold";
+        case HEAP_LIMIT:
+            return "heap-limit";
+        default:
+            return "unknown";
+    }
+}
+
+const char *GcStats::name(ListKind kind) {
+    switch (kind) {
+        case GENERIC_LIST:
+            return "generic";
+        case STRING_LIST:
+            return "string";
+        case INT_LIST:
+            return "int";
+        default:
+            return "unknown";
+    }
+}
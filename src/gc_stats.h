@@ -0,0 +1,79 @@
+#ifndef TEETON_GC_STATS_H
+#define TEETON_GC_STATS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "enums.h"
+
+// Pause times of the collector bucketed by powers of two microseconds.
+class PauseHistogram {
+public:
+    void record(std::chrono::steady_clock::duration pause);
+
+    void printText(std::ostream &os);
+
+    void printJson(std::ostream &os);
+
+private:
+    static const unsigned Buckets = 24;
+
+    unsigned counts[Buckets] = {};
+    unsigned pauses = 0;
+    double total = 0;
+    double longest = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+// One major collection, from the start of marking until the last slab is swept. Times are in milliseconds. The
+// sizes after the cycle are only known once it is finished.
+struct GcCycle {
+    GcTrigger trigger;
+    size_t objectsBefore;
+    size_t bytesBefore;
+    bool finished = false;
+    size_t objectsAfter = 0;
+    size_t bytesAfter = 0;
+    double markTime = 0;
+    double sweepTime = 0;
+    unsigned markSteps = 0;
+    unsigned sweepSteps = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+// Telemetry of the garbage collector, printed at exit with --gc-stats.
+class GcStats {
+public:
+    GcStats() : start(std::chrono::steady_clock::now()) { };
+
+    void printText(std::ostream &os);
+
+    void printJson(std::ostream &os);
+
+    static double milliseconds(std::chrono::steady_clock::duration time);
+
+    static const char *name(ListKind kind);
+
+    std::chrono::steady_clock::time_point start;
+    std::vector<GcCycle> cycles;
+    PauseHistogram pauses;
+    unsigned collections[GC_TRIGGER_COUNT] = {};
+    unsigned minorCollections = 0;
+    double minorTime = 0;
+    size_t promotedLists = 0;
+    size_t allocatedLists = 0;
+    size_t allocatedBytes = 0;  // list headers, storage is counted by ListStorage
+
+private:
+    static std::string after(GcCycle &cycle, size_t size);
+
+    static std::string rate(size_t bytes, double seconds);
+
+    static const char *name(GcTrigger trigger);
+};
+
+#endif //TEETON_GC_STATS_H
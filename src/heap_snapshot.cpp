@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "environment.h"
+#include "heap_snapshot.h"
+
+using namespace std;
+
+const char *HeapSnapshot::Header = "teeton-heap-snapshot 1";
+
+// Lists are numbered in the order they are reached from the roots.
+void HeapSnapshot::write(Environment *env, ostream &os) {
+    unordered_map<TypeList *, unsigned> lists;
+    unordered_map<SourceLocation *, unsigned> sites;
+    vector<TypeList *> pending;
+
+    auto idOf = [&](TypeList *list) {
+        auto it = lists.find(list);
+        if (it != lists.end()) {
+            return it->second;
+        }
+        unsigned id = (unsigned) lists.size() + 1;
+        lists[list] = id;
+        pending.push_back(list);
+        return id;
+    };
+
+    os << Header << endl;
+
+    for (unsigned slot = 0; slot < env->variables.size(); slot++) {
+        if (env->variables[slot].isList()) {
+            os << "root " << idOf(env->variables[slot].listValue()) << " " << env->symbols->name(slot) << endl;
+        }
+    }
+    for (auto const &root : env->roots) {
+        if (root->isList()) {
+            os << "root " << idOf(root->listValue()) << " <temporary>" << endl;
+        }
+    }
+
+    while (!pending.empty()) {
+        TypeList *list = pending.back();
+        pending.pop_back();
+
+        unsigned site = 0;
+        if (list->site != nullptr) {
+            auto it = sites.find(list->site);
+            site = it != sites.end() ? it->second : (sites[list->site] = (unsigned) sites.size() + 1);
+        }
+
+        os << "list " << lists[list] << " " << GcStats::name(list->kind()) << " " << list->size() << " "
+        << sizeof(TypeList) + list->storageBytes() << " " << site;
+
+        Value *references = list->references();
+        for (unsigned i = 0; references != nullptr && i < list->size(); i++) {
+            if (references[i].isList()) {
+                os << " " << idOf(references[i].listValue());
+            }
+        }
+        os << endl;
+    }
+
+    for (auto &it : sites) {
+        string node = it.first->node;
+        replace(node.begin(), node.end(), '\n', ' ');
+        os << "site " << it.second << " " << it.first->lineIndex << " " << it.first->colIndex << " " << node << endl;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+namespace {
+    struct SiteSummary {
+        string location = "unknown";
+        size_t bytes = 0;
+        size_t lists = 0;
+    };
+}
+
+bool HeapSnapshot::summarize(istream &is, ostream &os) {
+    string line;
+    if (!getline(is, line) || line != Header) {
+        return false;
+    }
+
+    map<unsigned, SiteSummary> sites;
+    map<string, size_t> kinds;
+    size_t totalBytes = 0;
+    size_t totalLists = 0;
+
+    while (getline(is, line)) {
+        istringstream record(line);
+        string type;
+        record >> type;
+
+        if (type == "list") {
+            unsigned id, length, site;
+            size_t bytes;
+            string kind;
+            if (!(record >> id >> kind >> length >> bytes >> site)) {
+                return false;
+            }
+            sites[site].bytes += bytes;
+            sites[site].lists++;
+            kinds[kind] += bytes;
+            totalBytes += bytes;
+            totalLists++;
+        } else if (type == "site") {
+            unsigned id;
+            int lineIndex, colIndex;
+            string node;
+            if (!(record >> id >> lineIndex >> colIndex)) {
+                return false;
+            }
+            getline(record >> ws, node);
+
+            ostringstream location;
+            location << lineIndex << ":" << colIndex << " " << node;
+            sites[id].location = location.str();
+        } else if (type != "root") {
+            return false;
+        }
+    }
+
+    vector<SiteSummary> bySize;
+    for (auto &it : sites) {
+        if (it.second.lists > 0) {
+            bySize.push_back(it.second);
+        }
+    }
+    sort(bySize.begin(), bySize.end(), [](const SiteSummary &a, const SiteSummary &b) { return a.bytes > b.bytes; });
+
+    os << "live lists: " << totalLists << ", " << totalBytes << " bytes" << endl;
+    for (auto &it : kinds) {
+        os << "  " << left << setw(8) << it.first << right << setw(12) << it.second << " bytes" << endl;
+    }
+    os << endl;
+    os << setw(12) << "bytes" << setw(10) << "lists" << "  allocation site" << endl;
+    for (auto const &site : bySize) {
+        os << setw(12) << site.bytes << setw(10) << site.lists << "  " << site.location << endl;
+    }
+
+    return true;
+}
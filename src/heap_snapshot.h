@@ -0,0 +1,23 @@
+#ifndef TEETON_HEAP_SNAPSHOT_H
+#define TEETON_HEAP_SNAPSHOT_H
+
+#include <istream>
+#include <ostream>
+
+class Environment;
+
+// Live lists of a running program written as text, one record per line:
+//   root <list> <variable>
+//   list <id> <kind> <length> <bytes> <site> <referenced lists>...
+//   site <id> <line> <column> <node>
+// The summary groups the live bytes by the source location which allocated them.
+class HeapSnapshot {
+public:
+    static void write(Environment *env, std::ostream &os);
+
+    static bool summarize(std::istream &is, std::ostream &os);
+
+    static const char *Header;
+};
+
+#endif //TEETON_HEAP_SNAPSHOT_H
@@ -0,0 +1,732 @@
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define TEETON_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "environment.h"
+#include "jit.h"
+#include "node.h"
+
+using namespace std;
+
+Jit::~Jit() {
+    for (auto const &code : loops) {
+#if defined(TEETON_JIT)
+        if (code->memory != nullptr) {
+            munmap(code->memory, code->size);
+        }
+#endif
+        delete code;
+    }
+}
+
+bool Jit::supported() {
+#if defined(TEETON_JIT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitResult Jit::run(NodeWhile *loop, JitLoop **compiled, Environment *env) {
+    if (*compiled == nullptr) {
+        *compiled = compile(loop);
+    }
+    JitLoop *code = *compiled;
+    if (code->function == nullptr) {
+        return JIT_INTERPRET;
+    }
+
+    // the helpers never resize the variables, the code keeps pointers to them
+    if (env->variables.size() < code->slots) {
+        env->variables.resize(code->slots);
+        env->defined.resize(code->slots, false);
+    }
+    JitFrame frame = {env->variables.data(), env->defined.data(), env, &env->identity, Value()};
+    unsigned exit = code->function(&frame);
+    if (exit == 0) {
+        return JIT_FINISHED;
+    }
+
+    const JitResume &stop = code->resumes[exit - 1];
+    if (!stop.poll && ++code->bails == MaxBails) {
+        code->function = nullptr;
+    }
+    if (stop.frames.empty()) {
+        return stop.poll ? JIT_CONTINUE : JIT_INTERPRET;
+    }
+    return resume(env, stop.frames) ? JIT_CONTINUE : JIT_FINISHED;
+}
+
+JitLoop *Jit::compile(NodeWhile *loop) {
+    JitLoop *code = new JitLoop();
+    loops.push_back(code);
+
+    JitCompiler compiler(code);
+    if (!compiler.compile(loop)) {
+        code->resumes.clear();
+        return code;
+    }
+
+#if defined(TEETON_JIT)
+    vector<uint8_t> bytes = compiler.finish();
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = (bytes.size() + page - 1) / page * page;
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return code;
+    }
+    memcpy(memory, bytes.data(), bytes.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return code;
+    }
+
+    code->memory = memory;
+    code->size = size;
+    code->function = reinterpret_cast<JitFunction>(memory);
+#endif
+    return code;
+}
+
+// Runs the rest of the statements from the innermost block outwards. Returns false when the rest
+// of the hot loop broke out of it or failed, the error is left pending for the loop to return.
+bool Jit::resume(Environment *env, const vector<ResumeFrame> &frames) {
+    bool broken = false;
+    for (size_t level = frames.size(); level-- > 0;) {
+        const ResumeFrame &frame = frames[level];
+        if (!broken) {
+            // the statements around an inner block are done with it
+            frame.block->evaluateFrom(env, level == frames.size() - 1 ? frame.index : frame.index + 1);
+            if (env->completion == BREAK_COMPLETION) {
+                env->completion = NORMAL_COMPLETION;
+                broken = true;
+            } else if (env->abrupt()) {
+                return false;
+            }
+        }
+
+        if (frame.loop == nullptr) {
+            continue;
+        }
+        if (level == 0) {
+            return !broken;
+        }
+        if (broken) {
+            broken = false;
+        } else {
+            frame.loop->evaluate(env);
+            if (env->abrupt()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// -- Helpers ------------------------------------------------------------------
+
+unsigned Jit::poll(Environment *env) {
+    return Environment::snapshotRequested || env->heapBytes() >= env->collectionTrigger;
+}
+
+int64_t Jit::length(Value list) {
+    return list.isList() ? (int64_t) (uint32_t) list.listValue()->size() : -1;
+}
+
+unsigned Jit::get(Value list, Value index, Value *result) {
+    if (!list.isList() || index.type() != INT || (unsigned) index.intValue() >= list.listValue()->size()) {
+        return 0;
+    }
+    *result = list.listValue()->get((unsigned) index.intValue());
+    return 1;
+}
+
+// Constant lists are left to the interpreter, materializing them allocates.
+unsigned Jit::set(Environment *env, Value list, Value index, Value value) {
+    if (!list.isList() || list.listValue()->isConstant() || (value.isList() && value.listValue()->isConstant())) {
+        return 0;
+    }
+    TypeList *target = list.listValue();
+    if (index.type() != INT || (unsigned) index.intValue() >= target->size()) {
+        return 0;
+    }
+    target->set((unsigned) index.intValue(), value);
+    env->writeBarrier(target, (unsigned) index.intValue(), value);
+    return 1;
+}
+
+unsigned Jit::append(Environment *env, Value list, Value value) {
+    if (!list.isList() || list.listValue()->isConstant() || (value.isList() && value.listValue()->isConstant())) {
+        return 0;
+    }
+    TypeList *target = list.listValue();
+    target->append(value);
+    env->writeBarrier(target, target->size() - 1, value);
+    return 1;
+}
+
+void Jit::print(Value value, unsigned breakLine) {
+    cout << value.toString();
+    if (breakLine) {
+        cout << endl;
+    }
+}
+
+unsigned Jit::storeList(Environment *env, unsigned slot, Value value) {
+    if (value.listValue()->isConstant()) {
+        return 0;
+    }
+    env->setVariable(slot, value);
+    return 1;
+}
+
+// -- JitCompiler --------------------------------------------------------------
+
+// Registers holding the state of the loop, they are preserved across calls.
+static const Register Variables = RBX;
+static const Register Defined = R12;
+static const Register Env = R13;
+static const Register Frame = R14;
+static const Register Identity = R15;
+
+static Condition conditionOf(Operator op) {
+    switch (op) {
+        case EQ:
+            return CC_E;
+        case NEQ:
+            return CC_NE;
+        case GT:
+            return CC_G;
+        case LT:
+            return CC_L;
+        case GTE:
+            return CC_GE;
+        default:
+            return CC_LE;
+    }
+}
+
+bool JitCompiler::compile(NodeWhile *loop) {
+    Assembler &a = assembler;
+    a.push(RBP);
+    a.mov(RBP, RSP);
+    a.push(RBX);
+    a.push(R12);
+    a.push(R13);
+    a.push(R14);
+    a.push(R15);
+    a.alu(ALU_SUB, RSP, 8, true);
+    a.mov(Frame, RDI);
+    a.load(Variables, RDI, offsetof(JitFrame, variables));
+    a.load(Defined, RDI, offsetof(JitFrame, defined));
+    a.load(Env, RDI, offsetof(JitFrame, env));
+    a.load(Identity, RDI, offsetof(JitFrame, identity));
+
+    epilogue = a.label();
+    if (!loop->jit(this)) {
+        return false;
+    }
+    a.immediate(RAX, 0);
+
+    a.bind(epilogue);
+    a.lea(RSP, RBP, -40);
+    a.pop(R15);
+    a.pop(R14);
+    a.pop(R13);
+    a.pop(R12);
+    a.pop(RBX);
+    a.pop(RBP);
+    a.ret();
+
+    for (auto const &stub : stubs) {
+        a.bind(stub.first);
+        a.immediate(RAX, stub.second);
+        a.jmp(epilogue);
+    }
+    return true;
+}
+
+void JitCompiler::constant(Value value) {
+    assembler.immediate(RAX, value.bits);
+}
+
+// An undefined variable is left to the interpreter, which reports it.
+void JitCompiler::loadVariable(unsigned slot) {
+    code->slots = max(code->slots, slot + 1);
+    assembler.loadByte(RCX, Defined, (int32_t) slot);
+    assembler.test(RCX, RCX);
+    bail(CC_E);
+    assembler.load(RAX, Variables, (int32_t) slot * 8);
+}
+
+// Scalars are stored directly, lists go through the write barrier of the environment.
+void JitCompiler::storeVariable(unsigned slot) {
+    Assembler &a = assembler;
+    code->slots = max(code->slots, slot + 1);
+    unsigned scalar = a.label();
+    unsigned done = a.label();
+    a.mov32(RCX, RAX);
+    a.alu(ALU_AND, RCX, (int32_t) Value::TagMask);
+    a.jcc(CC_NE, scalar);
+    a.test(RAX, RAX, true);
+    a.jcc(CC_E, scalar);
+
+    a.mov(RDX, RAX);
+    a.immediate(RSI, slot);
+    a.mov(RDI, Env);
+    call((uintptr_t) &Jit::storeList);
+    a.test(RAX, RAX);
+    bail(CC_E);
+    a.jmp(done);
+
+    a.bind(scalar);
+    a.store(Variables, (int32_t) slot * 8, RAX);
+    a.storeByte(Defined, (int32_t) slot, 1);
+    a.bind(done);
+}
+
+void JitCompiler::push() {
+    assembler.push(RAX);
+    depth++;
+}
+
+void JitCompiler::pop(Register r) {
+    assembler.pop(r);
+    depth--;
+}
+
+void JitCompiler::guard(Type type, Register r) {
+    assembler.mov32(RDX, r);
+    assembler.alu(ALU_AND, RDX, (int32_t) Value::TagMask);
+    assembler.alu(ALU_CMP, RDX, (int32_t) (type == INT ? Value::TagInt : Value::TagBool));
+    bail(CC_NE);
+}
+
+// Operands of different types are reported by the interpreter.
+void JitCompiler::sameTypes() {
+    assembler.mov32(RDX, RAX);
+    assembler.alu(ALU_XOR, RDX, RCX);
+    assembler.alu(ALU_AND, RDX, (int32_t) Value::TagMask);
+    bail(CC_NE);
+}
+
+// Pops the first operand into RCX and checks both, leaves the payloads of scalars in ECX and EAX.
+void JitCompiler::operands(Operator op) {
+    pop(RCX);
+    if (op == EQ || op == NEQ) {
+        // lists compare their elements
+        sameTypes();
+        assembler.mov32(RDX, RAX);
+        assembler.alu(ALU_AND, RDX, (int32_t) Value::TagMask);
+        bail(CC_E);
+    } else if (op == AND || op == OR) {
+        guard(BOOL, RCX);
+        guard(BOOL, RAX);
+    } else {
+        guard(INT, RCX);
+        guard(INT, RAX);
+    }
+    assembler.shift(SHIFT_SHR, RCX, Value::PayloadShift);
+    assembler.shift(SHIFT_SHR, RAX, Value::PayloadShift);
+}
+
+void JitCompiler::binary(Operator op) {
+    Assembler &a = assembler;
+    if (op == EQEQ) {
+        pop(RCX);
+        sameTypes();
+        a.alu(ALU_CMP, RCX, RAX, true);
+        a.setcc(CC_E, RCX);
+        box(Value::TagBool, RCX);
+        return;
+    }
+
+    operands(op);
+    switch (op) {
+        case ADD:
+            a.alu(ALU_ADD, RCX, RAX);
+            break;
+        case SUB:
+            a.alu(ALU_SUB, RCX, RAX);
+            break;
+        case MUL:
+            a.imul32(RCX, RAX);
+            break;
+        case DIV:
+        case MOD: {
+            // the interpreter traps on a zero divisor and on INT_MIN / -1
+            unsigned divide = a.label();
+            a.test(RAX, RAX);
+            bail(CC_E);
+            a.alu(ALU_CMP, RAX, -1);
+            a.jcc(CC_NE, divide);
+            a.alu(ALU_CMP, RCX, INT32_MIN);
+            bail(CC_E);
+            a.bind(divide);
+            a.mov32(RSI, RAX);
+            a.mov32(RAX, RCX);
+            a.idiv32(RSI);
+            a.mov32(RCX, op == DIV ? RAX : RDX);
+            break;
+        }
+        case AND:
+            a.alu(ALU_AND, RCX, RAX);
+            break;
+        case OR:
+            a.alu(ALU_OR, RCX, RAX);
+            break;
+        default:
+            a.alu(ALU_CMP, RCX, RAX);
+            a.setcc(conditionOf(op), RCX);
+            break;
+    }
+    box(op <= MOD ? Value::TagInt : Value::TagBool, RCX);
+}
+
+// Comparisons jump on the flags without making a bool.
+void JitCompiler::branch(Operator op, unsigned falseLabel) {
+    if (op < EQ || op == EQEQ || op > LTE) {
+        binary(op);
+        branchIfFalse(falseLabel);
+        return;
+    }
+
+    operands(op);
+    assembler.alu(ALU_CMP, RCX, RAX);
+    assembler.jcc(Assembler::negate(conditionOf(op)), falseLabel);
+}
+
+void JitCompiler::branchIfFalse(unsigned falseLabel) {
+    guard(BOOL, RAX);
+    assembler.shift(SHIFT_SHR, RAX, Value::PayloadShift);
+    assembler.test(RAX, RAX);
+    assembler.jcc(CC_E, falseLabel);
+}
+
+void JitCompiler::negate() {
+    guard(BOOL, RAX);
+    assembler.shift(SHIFT_SHR, RAX, Value::PayloadShift);
+    assembler.mov32(RCX, RAX);
+    assembler.alu(ALU_XOR, RCX, 1);
+    box(Value::TagBool, RCX);
+}
+
+void JitCompiler::length() {
+    assembler.mov(RDI, RAX);
+    call((uintptr_t) &Jit::length);
+    assembler.test(RAX, RAX, true);
+    bail(CC_S);
+    assembler.mov32(RCX, RAX);
+    box(Value::TagInt, RCX);
+}
+
+void JitCompiler::get() {
+    assembler.mov(RSI, RAX);
+    pop(RDI);
+    assembler.lea(RDX, Frame, offsetof(JitFrame, result));
+    call((uintptr_t) &Jit::get);
+    assembler.test(RAX, RAX);
+    bail(CC_E);
+    assembler.load(RAX, Frame, offsetof(JitFrame, result));
+}
+
+void JitCompiler::set() {
+    assembler.mov(RCX, RAX);
+    pop(RDX);
+    pop(RSI);
+    assembler.mov(RDI, Env);
+    call((uintptr_t) &Jit::set);
+    assembler.test(RAX, RAX);
+    bail(CC_E);
+}
+
+void JitCompiler::append() {
+    assembler.mov(RDX, RAX);
+    pop(RSI);
+    assembler.mov(RDI, Env);
+    call((uintptr_t) &Jit::append);
+    assembler.test(RAX, RAX);
+    bail(CC_E);
+}
+
+void JitCompiler::print(bool breakLine) {
+    assembler.mov(RDI, RAX);
+    assembler.immediate(RSI, breakLine);
+    call((uintptr_t) &Jit::print);
+}
+
+// Boxes the payload into RAX with the next identity, as Environment::makeInt and makeBool do. Once the
+// identities run out the interpreter reports the error.
+void JitCompiler::box(uint64_t tag, Register payload) {
+    Assembler &a = assembler;
+    a.load32(RDX, Identity, 0);
+    a.alu(ALU_CMP, RDX, (int32_t) Value::RuntimeIdentityMask);
+    bail(CC_G);
+    a.lea(RSI, RDX, 1);
+    a.store32(Identity, 0, RSI);
+    a.shift(SHIFT_SHL, RDX, Value::IdentityShift);
+    a.alu(ALU_OR, RDX, (int32_t) tag, true);
+    a.mov32(RAX, payload);
+    a.shift(SHIFT_SHL, RAX, Value::PayloadShift);
+    a.alu(ALU_OR, RAX, RDX, true);
+}
+
+// The stack is aligned to 16 bytes at calls, the prologue leaves it aligned without pushed values.
+void JitCompiler::call(uintptr_t function) {
+    if (depth % 2 != 0) {
+        assembler.alu(ALU_SUB, RSP, 8, true);
+    }
+    assembler.immediate(R11, function);
+    assembler.call(R11);
+    if (depth % 2 != 0) {
+        assembler.alu(ALU_ADD, RSP, 8, true);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void JitCompiler::enterBlock(NodeBlock *block, NodeWhile *loop) {
+    ResumeFrame frame = {block, block->size(), loop};
+    frames.push_back(frame);
+    resumeChanged();
+}
+
+void JitCompiler::statement(unsigned index, AbstractNode *node) {
+    frames.back().index = index;
+    current = node;
+    resumeChanged();
+}
+
+void JitCompiler::leaveBlock() {
+    frames.pop_back();
+    current = nullptr;
+    resumeChanged();
+}
+
+bool JitCompiler::breakLoop() {
+    if (exits.empty()) {
+        return false;
+    }
+    assembler.jmp(exits.back());
+    return true;
+}
+
+void JitCompiler::poll() {
+    assembler.mov(RDI, Env);
+    call((uintptr_t) &Jit::poll);
+    assembler.test(RAX, RAX);
+    bail(CC_NE, true);
+}
+
+// Jumps out of the code when the condition holds, the interpreter continues from the statement being
+// compiled. Before the first statement of the hot loop it continues with its condition.
+void JitCompiler::bail(Condition condition, bool poll) {
+    int &stub = poll ? pollStub : bailStub;
+    if (stub < 0) {
+        stub = (int) assembler.label();
+        JitResume resume;
+        resume.poll = poll;
+        if (frames.size() > 1 || frames[0].index != frames[0].block->size()) {
+            resume.frames = frames;
+        }
+        code->resumes.push_back(resume);
+        stubs.push_back(make_pair((unsigned) stub, (unsigned) code->resumes.size()));
+    }
+    assembler.jcc(condition, (unsigned) stub);
+}
+
+void JitCompiler::resumeChanged() {
+    bailStub = -1;
+    pollStub = -1;
+}
+
+// -- Nodes --------------------------------------------------------------------
+
+bool AbstractNode::jit(JitCompiler *compiler) {
+    return false;
+}
+
+bool AbstractNode::jitCondition(JitCompiler *compiler, unsigned falseLabel) {
+    if (!jit(compiler)) {
+        return false;
+    }
+    compiler->branchIfFalse(falseLabel);
+    return true;
+}
+
+bool NodeBlock::jit(JitCompiler *compiler) {
+    for (unsigned i = 0; i < nodes->size(); i++) {
+        compiler->statement(i, (*nodes)[i]);
+        if (!(*nodes)[i]->jit(compiler)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NodeVariableDefinition::jit(JitCompiler *compiler) {
+    if (!value->jit(compiler)) {
+        return false;
+    }
+    compiler->storeVariable(slot);
+    return true;
+}
+
+bool NodeVariableName::jit(JitCompiler *compiler) {
+    compiler->loadVariable(slot);
+    return true;
+}
+
+bool NodePrint::jit(JitCompiler *compiler) {
+    if (!value->jit(compiler)) {
+        return false;
+    }
+    compiler->print(breakLine);
+    return true;
+}
+
+bool NodeBinaryOperator::jit(JitCompiler *compiler) {
+    if (!a->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!b->jit(compiler)) {
+        return false;
+    }
+    compiler->binary(op);
+    return true;
+}
+
+bool NodeBinaryOperator::jitCondition(JitCompiler *compiler, unsigned falseLabel) {
+    if (!a->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!b->jit(compiler)) {
+        return false;
+    }
+    compiler->branch(op, falseLabel);
+    return true;
+}
+
+bool NodeNotOperator::jit(JitCompiler *compiler) {
+    if (!a->jit(compiler)) {
+        return false;
+    }
+    compiler->negate();
+    return true;
+}
+
+// Constant lists are materialized when they are stored, which allocates.
+bool NodeConstant::jit(JitCompiler *compiler) {
+    if (value.isList()) {
+        return false;
+    }
+    compiler->constant(value);
+    return true;
+}
+
+bool NodeWhile::jit(JitCompiler *compiler) {
+    unsigned head = compiler->label();
+    unsigned exit = compiler->label();
+    compiler->bind(head);
+    compiler->enterBlock(block, this);
+    compiler->poll();
+    if (!condition->jitCondition(compiler, exit)) {
+        return false;
+    }
+
+    compiler->enterLoop(exit);
+    if (!block->jit(compiler)) {
+        return false;
+    }
+    compiler->leaveLoop();
+    compiler->jump(head);
+    compiler->leaveBlock();
+    compiler->bind(exit);
+    return true;
+}
+
+bool NodeIfElse::jit(JitCompiler *compiler) {
+    unsigned otherwise = compiler->label();
+    unsigned end = compiler->label();
+    if (!condition->jitCondition(compiler, otherwise)) {
+        return false;
+    }
+
+    compiler->enterBlock(ifBlock);
+    if (!ifBlock->jit(compiler)) {
+        return false;
+    }
+    compiler->leaveBlock();
+    compiler->jump(end);
+
+    compiler->bind(otherwise);
+    compiler->enterBlock(elseBlock);
+    if (!elseBlock->jit(compiler)) {
+        return false;
+    }
+    compiler->leaveBlock();
+    compiler->bind(end);
+    return true;
+}
+
+bool NodeBreak::jit(JitCompiler *compiler) {
+    return compiler->breakLoop();
+}
+
+bool NodeLen::jit(JitCompiler *compiler) {
+    if (!expression->jit(compiler)) {
+        return false;
+    }
+    compiler->length();
+    return true;
+}
+
+// The interpreter repeats the statement after a failed guard, so the effects of append and set
+// are only compiled when they are the statement.
+bool NodeAppend::jit(JitCompiler *compiler) {
+    if (!compiler->isStatement(this) || !listExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!valueExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->append();
+    return true;
+}
+
+bool NodeGet::jit(JitCompiler *compiler) {
+    if (!listExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!indexExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->get();
+    return true;
+}
+
+bool NodeSet::jit(JitCompiler *compiler) {
+    if (!compiler->isStatement(this) || !listExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!indexExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->push();
+    if (!valueExpression->jit(compiler)) {
+        return false;
+    }
+    compiler->set();
+    return true;
+}
@@ -0,0 +1,185 @@
+#ifndef TEETON_JIT_H
+#define TEETON_JIT_H
+
+#include <vector>
+
+#include "assembler.h"
+#include "type.h"
+
+class AbstractNode;
+
+class NodeBlock;
+
+class NodeWhile;
+
+enum JitResult {
+    JIT_INTERPRET,  // the interpreter runs the iteration
+    JIT_CONTINUE,  // the interpreter goes on with the next iteration
+    JIT_FINISHED  // the loop is over
+};
+
+// Statement the interpreter continues from when the native code bails out, one for every block
+// the statement is nested in. The rest of the body of a loop is followed by the rest of the loop.
+struct ResumeFrame {
+    NodeBlock *block;
+    unsigned index;
+    NodeWhile *loop;
+};
+
+// Where the native code stopped. Without frames it stopped at the start of an iteration of the hot loop.
+struct JitResume {
+    std::vector<ResumeFrame> frames;
+    bool poll;  // stopped for a safepoint, not at a failed guard
+};
+
+// State the native code is called with.
+struct JitFrame {
+    Value *variables;
+    char *defined;
+    Environment *env;
+    unsigned *identity;
+    Value result;  // element read by get
+};
+
+typedef unsigned (*JitFunction)(JitFrame *frame);
+
+// Native code of a loop, it returns 0 when the loop is over and 1 + index of the resume otherwise.
+struct JitLoop {
+    JitFunction function = nullptr;
+    void *memory = nullptr;
+    size_t size = 0;
+    unsigned slots = 0;  // the code uses variables below slots
+    unsigned bails = 0;
+    std::vector<JitResume> resumes;
+};
+
+// Compiles hot while loops of the tree walker to x86-64 code. The native code keeps values boxed
+// and takes identities like the interpreter, it checks types and everything that could fail before
+// a statement has any effect and leaves the statement to the interpreter when a check fails.
+class Jit {
+public:
+    ~Jit();
+
+    static bool supported();
+
+    // called at the start of every iteration once the loop is hot, compiled caches the code of the loop
+    JitResult run(NodeWhile *loop, JitLoop **compiled, Environment *env);
+
+    static const unsigned HotLoop = 1000;  // iterations before a loop is compiled
+    static const unsigned MaxBails = 64;  // failed guards before the code of a loop is dropped
+
+private:
+    JitLoop *compile(NodeWhile *loop);
+
+    bool resume(Environment *env, const std::vector<ResumeFrame> &frames);
+
+    // helpers called by the native code, they fail before any effect
+    static unsigned poll(Environment *env);
+
+    static int64_t length(Value list);
+
+    static unsigned get(Value list, Value index, Value *result);
+
+    static unsigned set(Environment *env, Value list, Value index, Value value);
+
+    static unsigned append(Environment *env, Value list, Value value);
+
+    static void print(Value value, unsigned breakLine);
+
+    static unsigned storeList(Environment *env, unsigned slot, Value value);
+
+    std::vector<JitLoop *> loops;
+
+    friend class JitCompiler;
+};
+
+// -----------------------------------------------------------------------------
+
+// Emits the native code of a loop for the nodes. Expressions leave their boxed value in RAX, the
+// operands of an operation are pushed on the native stack before the last one is evaluated.
+class JitCompiler {
+public:
+    JitCompiler(JitLoop *code) : code(code) { };
+
+    bool compile(NodeWhile *loop);
+
+    std::vector<uint8_t> finish() { return assembler.finish(); };
+
+    void constant(Value value);
+
+    void loadVariable(unsigned slot);
+
+    void storeVariable(unsigned slot);
+
+    void push();
+
+    void binary(Operator op);
+
+    void branch(Operator op, unsigned falseLabel);
+
+    void branchIfFalse(unsigned falseLabel);
+
+    void negate();
+
+    void length();
+
+    void get();
+
+    void set();
+
+    void append();
+
+    void print(bool breakLine);
+
+    unsigned label() { return assembler.label(); };
+
+    void bind(unsigned label) { assembler.bind(label); };
+
+    void jump(unsigned label) { assembler.jmp(label); };
+
+    void enterBlock(NodeBlock *block, NodeWhile *loop = nullptr);
+
+    void statement(unsigned index, AbstractNode *node);
+
+    bool isStatement(AbstractNode *node) { return node == current; };
+
+    void leaveBlock();
+
+    void enterLoop(unsigned exit) { exits.push_back(exit); };
+
+    void leaveLoop() { exits.pop_back(); };
+
+    bool breakLoop();
+
+    void poll();
+
+private:
+    void pop(Register r);
+
+    void guard(Type type, Register r);
+
+    void sameTypes();
+
+    void operands(Operator op);
+
+    void box(uint64_t tag, Register payload);
+
+    void call(uintptr_t function);
+
+    void bail(Condition condition, bool poll = false);
+
+    void resumeChanged();
+
+    Assembler assembler;
+    JitLoop *code;
+    unsigned depth = 0;  // values pushed by expressions
+    unsigned epilogue = 0;
+    std::vector<ResumeFrame> frames;
+    AbstractNode *current = nullptr;  // statement being compiled
+    std::vector<unsigned> exits;  // labels after the enclosing loops
+    int bailStub = -1;
+    int pollStub = -1;
+    std::vector<std::pair<unsigned, unsigned>> stubs;  // labels returning the index of a resume
+};
+
+#endif //TEETON_JIT_H
@@ -1,26 +1,243 @@
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
 #include "type.h"
+#include "ast_dumper.h"
+#include "c_emitter.h"
+#include "compiler.h"
 #include "environment.h"
+#include "heap_snapshot.h"
+#include "jit.h"
 #include "node.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "type_inference.h"
+#include "vm.h"
 
 using namespace std;
 
+// -- Options ------------------------------------------------------------------
+
+enum StatsFormat {
+    NO_STATS, TEXT_STATS, JSON_STATS
+};
+
+enum Engine {
+    AST_ENGINE,  // walks the tree
+    CLOSURE_ENGINE,  // turns the tree into closures
+    VM_ENGINE  // compiles the tree to bytecode
+};
+
+struct Options {
+    HeapOptions heap;
+    Engine engine = AST_ENGINE;
+    bool jit = false;
+    bool emitC = false;
+    bool dumpAst = false;
+    unsigned optimization = 2;  // 0 runs the tree as parsed, 1 optimizes it, 2 also infers types
+    bool inferStats = false;
+    StatsFormat stats = NO_STATS;
+    std::string summary;
+    char *program = nullptr;
+};
+
+void usage() {
+    cout << "usage: teeton [options] [program]" << endl;
+    cout << "  --engine=ENGINE      ast walks the syntax tree (default), closure runs it turned into closures," << endl;
+    cout << "                       vm runs it compiled to bytecode" << endl;
+    cout << "  --jit                compile hot loops of the ast engine to x86-64 code" << endl;
+    cout << "  --emit-c             print the program translated to C instead of running it, see runtime/" << endl;
+    cout << "  -O0, -O1, -O2        optimization level, -O1 folds constants and removes dead code, -O2 (default)" << endl;
+    cout << "                       also specializes operators by inferred types" << endl;
+    cout << "  --dump-ast           print the optimized syntax tree instead of running the program" << endl;
+    cout << "  --infer-stats        print how many operators the type inference specialized" << endl;
+    cout << "  --heap-initial=SIZE  heap size before the first full collection (default 1M)" << endl;
+    cout << "  --heap-max=SIZE      hard limit of the live heap (default 1G)" << endl;
+    cout << "  --gc-pause=MICROS    time budget of one marking step (default 1000)" << endl;
+    cout << "  --gc-threads=N       number of threads marking the heap (default number of cores, at most 8)" << endl;
+    cout << "  --gc-stats[=FORMAT]  print statistics of the garbage collector at exit, FORMAT is text or json" << endl;
+    cout << "  --heap-snapshot=FILE write the live lists into FILE at exit and into FILE.N on SIGUSR1" << endl;
+    cout << "  --heap-summary=FILE  print the live bytes by allocation site of a heap snapshot" << endl;
+    cout << "SIZE is a number of bytes with an optional K, M or G suffix." << endl;
+    cout << "The TEETON_GC_STATS environment variable works as --gc-stats=$TEETON_GC_STATS." << endl;
+}
+
+bool parseSize(string value, size_t *size) {
+    size_t end;
+    unsigned long long number;
+    try {
+        number = stoull(value, &end);
+    } catch (exception &e) {
+        return false;
+    }
+
+    string suffix = value.substr(end);
+    if (suffix == "K" || suffix == "k") {
+        number <<= 10;
+    } else if (suffix == "M" || suffix == "m") {
+        number <<= 20;
+    } else if (suffix == "G" || suffix == "g") {
+        number <<= 30;
+    } else if (suffix != "") {
+        return false;
+    }
+
+    *size = (size_t) number;
+    return number > 0;
+}
+
+bool parseStatsFormat(string value, StatsFormat *format) {
+    if (value == "" || value == "text") {
+        *format = TEXT_STATS;
+    } else if (value == "json") {
+        *format = JSON_STATS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseOptions(int argc, char *argv[], Options *options) {
+    char *stats = getenv("TEETON_GC_STATS");
+    if (stats != nullptr && !parseStatsFormat(stats, &options->stats)) {
+        return false;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--engine=ast") {
+            options->engine = AST_ENGINE;
+        } else if (arg == "--engine=closure") {
+            options->engine = CLOSURE_ENGINE;
+        } else if (arg == "--engine=vm") {
+            options->engine = VM_ENGINE;
+        } else if (arg == "--jit") {
+            options->jit = true;
+        } else if (arg == "--emit-c") {
+            options->emitC = true;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            options->optimization = (unsigned) (arg[2] - '0');
+        } else if (arg == "--dump-ast") {
+            options->dumpAst = true;
+        } else if (arg == "--infer-stats") {
+            options->inferStats = true;
+        } else if (arg.compare(0, 15, "--heap-initial=") == 0) {
+            if (!parseSize(arg.substr(15), &options->heap.initialHeapSize)) return false;
+        } else if (arg.compare(0, 11, "--heap-max=") == 0) {
+            if (!parseSize(arg.substr(11), &options->heap.maxHeapSize)) return false;
+        } else if (arg.compare(0, 11, "--gc-pause=") == 0) {
+            size_t budget;
+            if (!parseSize(arg.substr(11), &budget)) return false;
+            options->heap.pauseBudget = (unsigned) budget;
+        } else if (arg.compare(0, 13, "--gc-threads=") == 0) {
+            size_t threads;
+            if (!parseSize(arg.substr(13), &threads)) return false;
+            options->heap.markThreads = (unsigned) min(threads, (size_t) 64);
+        } else if (arg.compare(0, 16, "--heap-snapshot=") == 0) {
+            options->heap.snapshotFile = arg.substr(16);
+        } else if (arg.compare(0, 15, "--heap-summary=") == 0) {
+            options->summary = arg.substr(15);
+        } else if (arg == "--gc-stats") {
+            options->stats = TEXT_STATS;
+        } else if (arg.compare(0, 11, "--gc-stats=") == 0) {
+            if (!parseStatsFormat(arg.substr(11), &options->stats)) return false;
+        } else if (arg.compare(0, 2, "--") == 0 || options->program != nullptr) {
+            return false;
+        } else {
+            options->program = argv[i];
+        }
+    }
+
+    options->heap.initialHeapSize = min(options->heap.initialHeapSize, options->heap.maxHeapSize);
+    return (!options->emitC && !options->dumpAst) || options->program != nullptr;
+}
+
 // -- Running program ----------------------------------------------------------
 
-void runProgram(char *path) {
-    ifstream file(path);
+void printStats(Options &options, Environment *env) {
+    if (options.stats == TEXT_STATS) {
+        env->stats.printText(cerr);
+    } else if (options.stats == JSON_STATS) {
+        env->stats.printJson(cerr);
+    }
+}
+
+AbstractNode *optimize(Options &options, AbstractNode *root, Parser *parser) {
+    if (options.optimization < 1) {
+        return root;
+    }
+
+    Optimizer optimizer(parser->constants);
+    return optimizer.run(root);
+}
+
+// Specializes the operators for the tree walker, the other engines resolve the types of operands themselves.
+AbstractNode *inferTypes(Options &options, AbstractNode *root, Environment *env, SymbolTable *symbols) {
+    if (options.engine != AST_ENGINE || options.optimization < 2) {
+        return root;
+    }
+
+    TypeInference inference(env, symbols->size());
+    root = inference.run(root);
+    if (options.inferStats) {
+        cerr << "type inference specialized " << inference.specialized << " of " << inference.sites
+             << " operators" << endl;
+    }
+    return root;
+}
+
+// A runtime error is left in the environment for the caller to report.
+Value evaluate(Options &options, AbstractNode *root, Environment *env) {
+    Value result;
+    if (options.engine == VM_ENGINE) {
+        Chunk chunk;
+        if (!Compiler::compile(root, &chunk)) {
+            return env->fail("Program is too large for the vm engine.");
+        }
+        Vm vm(&chunk, env);
+        result = vm.run();
+    } else if (options.engine == CLOSURE_ENGINE) {
+        result = root->close()(env);
+    } else {
+        result = root->evaluate(env);
+    }
+
+    // a break outside of any loop ends the program as it always did
+    if (env->completion == BREAK_COMPLETION) {
+        throw NodeBreak::BreakException();
+    }
+    return result;
+}
+
+void runProgram(Options &options) {
+    ifstream file(options.program);
     string source((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
 
     Parser *parser = new Parser();
+    Jit jit;
 
     try {
-        AbstractNode *root = parser->parse(source);
-        Environment *env = new Environment();
-        root->evaluate(env);
+        AbstractNode *root = optimize(options, parser->parse(source), parser);
+        Environment *env = new Environment(parser->symbols, options.heap);
+        if (options.jit) {
+            env->jit = &jit;
+        }
+        root = inferTypes(options, root, env, parser->symbols);
+        if (options.dumpAst) {
+            AstDumper::dump(root, parser->symbols, cout);
+        } else {
+            evaluate(options, root, env);
+        }
+        printStats(options, env);
+        if (!options.heap.snapshotFile.empty()) {
+            env->writeSnapshot(options.heap.snapshotFile);
+        }
+        if (env->completion == ERROR_COMPLETION) {
+            cout << env->error << endl;
+        }
         delete env;
         delete root;
     } catch (TeetonError *e) {
@@ -31,6 +248,28 @@ void runProgram(char *path) {
     delete parser;
 }
 
+// The generated program is printed to standard output, so errors go to standard error.
+int emitProgram(Options &options) {
+    ifstream file(options.program);
+    string source((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    Parser *parser = new Parser();
+    int status = 0;
+
+    try {
+        AbstractNode *root = optimize(options, parser->parse(source), parser);
+        CEmitter::emit(root, parser->symbols, cout);
+        delete root;
+    } catch (TeetonError *e) {
+        cerr << e->err << endl;
+        delete e;
+        status = 1;
+    }
+
+    delete parser;
+    return status;
+}
+
 // -- REPL ---------------------------------------------------------------------
 
 string readInput() {
@@ -38,7 +277,9 @@ string readInput() {
     vector<char> input;
 
     while (!(input.size() > 2 && input[input.size() - 1] == '\n' && input[input.size() - 2] == '\n')) {
-        cin >> noskipws >> c;
+        if (!(cin >> noskipws >> c)) {
+            break;
+        }
         input.push_back(c);
     }
 
@@ -51,35 +292,90 @@ string readInput() {
     return os.str();
 }
 
-void repl() {
+void repl(Options &options) {
     cout << "TEETON console " << endl;
     cout << "use ctrl + C to exit" << endl;
 
-    Environment *env = new Environment();
+    // the parser outlives every input, so a name keeps its slot and its value between inputs
     Parser *parser = new Parser();
+    Jit jit;
+    Environment *env = new Environment(parser->symbols, options.heap);
+    if (options.jit) {
+        env->jit = &jit;
+    }
 
     for (; ;) {
         cout << "T> ";
         string source = readInput();
+        if (cin.eof() && source.find_first_not_of(" \t\n") == string::npos) {
+            cout << endl;
+            break;
+        }
         try {
-            AbstractNode *root = parser->parse(source);
-            AbstractType *evaluated = root->evaluate(env);
-            if (evaluated != nullptr) {
-                cout << evaluated->toString() << endl;
+            AbstractNode *root = optimize(options, parser->parse(source), parser);
+            root = inferTypes(options, root, env, parser->symbols);
+            Value evaluated = evaluate(options, root, env);
+            if (env->completion == ERROR_COMPLETION) {
+                cout << env->error << endl;
+                env->completion = NORMAL_COMPLETION;
+            } else if (!evaluated.isNull()) {
+                cout << evaluated.toString() << endl;
             }
         } catch (TeetonError *e) {
             cout << e->err << endl;
             delete e;
         }
     }
+
+    delete env;
+    delete parser;
+}
+
+// -- Heap snapshots -----------------------------------------------------------
+
+void requestSnapshot(int signal) {
+    Environment::snapshotRequested = 1;
+}
+
+int summarize(Options &options) {
+    ifstream file(options.summary);
+    if (!HeapSnapshot::summarize(file, cout)) {
+        cout << options.summary << " is not a heap snapshot" << endl;
+        return 1;
+    }
+    return 0;
 }
 
 // -- main ---------------------------------------------------------------------
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        repl();
+    Options options;
+    if (!parseOptions(argc, argv, &options)) {
+        usage();
+        return 1;
+    }
+
+    if (!options.summary.empty()) {
+        return summarize(options);
+    }
+
+    if (options.emitC) {
+        return emitProgram(options);
+    }
+
+    if (options.jit && !Jit::supported()) {
+        cerr << "The JIT needs x86-64, running without it." << endl;
+        options.jit = false;
+    }
+
+    if (!options.heap.snapshotFile.empty()) {
+        signal(SIGUSR1, requestSnapshot);
+    }
+
+    if (options.program == nullptr) {
+        repl(options);
+    } else {
+        runProgram(options);
     }
-    runProgram(argv[1]);
     return 0;
 }
@@ -0,0 +1,175 @@
+#include "marker.h"
+#include "slab.h"
+
+using namespace std;
+using namespace std::chrono;
+
+Marker::Marker(unsigned threads) : active(0), expired(false) {
+    for (unsigned i = 0; i < max(threads, 1u); i++) {
+        workers.push_back(new Worker());
+    }
+    for (unsigned i = 1; i < workers.size(); i++) {
+        this->threads.push_back(thread(&Marker::run, this, i));
+    }
+}
+
+Marker::~Marker() {
+    {
+        lock_guard<mutex> guard(lock);
+        shutdown = true;
+    }
+    started.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto const &worker : workers) {
+        delete worker;
+    }
+}
+
+void Marker::shade(TypeList *list) {
+    if (tryMark(list)) {
+        push(0, {list, 0});
+    }
+}
+
+// Marks from the gray lists until the deadline, the lists left over stay on the stacks of the workers
+// for the next step. Returns true when marking is complete.
+bool Marker::mark(steady_clock::time_point deadline) {
+    this->deadline = deadline;
+    expired = false;
+    active = (unsigned) workers.size();
+
+    if (!threads.empty()) {
+        lock_guard<mutex> guard(lock);
+        running = (unsigned) threads.size();
+        generation++;
+    }
+    started.notify_all();
+
+    work(0);
+
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [this] { return running == 0; });
+
+    for (auto const &worker : workers) {
+        if (!worker->stack.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Marker::tryMark(TypeList *list) {
+    Slab *slab = Slab::of(list);
+    return slab->mark(slab->indexOf(list));
+}
+
+void Marker::run(unsigned id) {
+    unsigned seen = 0;
+
+    for (; ;) {
+        {
+            unique_lock<mutex> guard(lock);
+            started.wait(guard, [this, seen] { return shutdown || generation != seen; });
+            if (shutdown) {
+                return;
+            }
+            seen = generation;
+        }
+
+        work(id);
+
+        {
+            lock_guard<mutex> guard(lock);
+            running--;
+        }
+        finished.notify_one();
+    }
+}
+
+// A worker without work counts itself out of `active` while it tries to steal. Nobody pushes
+// work while inactive, so once no worker is active the marking is complete.
+void Marker::work(unsigned id) {
+    ListSlot entry;
+    unsigned scanned = 0;
+
+    for (; ;) {
+        if (!pop(id, &entry)) {
+            active--;
+            for (; ;) {
+                if (expired) {
+                    return;
+                }
+                active++;
+                if (steal(id, &entry)) {
+                    break;
+                }
+                if (--active == 0) {
+                    return;
+                }
+                this_thread::yield();
+            }
+        }
+
+        scan(id, entry);
+
+        scanned += Chunk;
+        if (scanned >= 4 * Chunk) {
+            scanned = 0;
+            if (steady_clock::now() >= deadline) {
+                expired = true;
+            }
+        }
+        if (expired) {
+            return;
+        }
+    }
+}
+
+void Marker::scan(unsigned id, ListSlot entry) {
+    Value *references = entry.list->references();
+    unsigned size = references == nullptr ? 0 : entry.list->size();
+    unsigned end = min(size, entry.index + Chunk);
+
+    // the rest of the list goes below its elements, it is the first thing other workers can steal
+    if (end < size) {
+        push(id, {entry.list, end});
+    }
+    for (unsigned i = entry.index; i < end; i++) {
+        if (references[i].isList() && tryMark(references[i].listValue())) {
+            push(id, {references[i].listValue(), 0});
+        }
+    }
+}
+
+void Marker::push(unsigned id, ListSlot entry) {
+    Worker *worker = workers[id];
+    lock_guard<mutex> guard(worker->lock);
+    worker->stack.push_back(entry);
+}
+
+bool Marker::pop(unsigned id, ListSlot *entry) {
+    Worker *worker = workers[id];
+    lock_guard<mutex> guard(worker->lock);
+    if (worker->stack.empty()) {
+        return false;
+    }
+    *entry = worker->stack.back();
+    worker->stack.pop_back();
+    return true;
+}
+
+bool Marker::steal(unsigned id, ListSlot *entry) {
+    for (unsigned i = 1; i < workers.size(); i++) {
+        Worker *victim = workers[(id + i) % workers.size()];
+        lock_guard<mutex> guard(victim->lock);
+        if (!victim->stack.empty()) {
+            *entry = victim->stack.front();
+            victim->stack.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
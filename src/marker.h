@@ -0,0 +1,72 @@
+#ifndef TEETON_MARKER_H
+#define TEETON_MARKER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "type.h"
+
+// Position in a list - a gray list on the mark stack and how far it was already scanned.
+struct ListSlot {
+    TypeList *list;
+    unsigned index;
+};
+
+// -----------------------------------------------------------------------------
+
+// Parallel marker of the old generation. Each worker drains its own stack of gray lists and steals
+// from the others when it runs out of work. Large lists are scanned in chunks, the rest of the list
+// goes back on the stack where another worker can steal it. The calling thread works as worker 0.
+class Marker {
+public:
+    Marker(unsigned threads);
+
+    ~Marker();
+
+    void shade(TypeList *list);
+
+    bool mark(std::chrono::steady_clock::time_point deadline);
+
+    static bool tryMark(TypeList *list);
+
+    static const unsigned Chunk = 256;
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<ListSlot> stack;
+    };
+
+    void run(unsigned id);
+
+    void work(unsigned id);
+
+    void scan(unsigned id, ListSlot entry);
+
+    void push(unsigned id, ListSlot entry);
+
+    bool pop(unsigned id, ListSlot *entry);
+
+    bool steal(unsigned id, ListSlot *entry);
+
+    std::vector<Worker *> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    unsigned generation = 0;
+    unsigned running = 0;
+    bool shutdown = false;
+
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<unsigned> active;
+    std::atomic<bool> expired;
+};
+
+#endif //TEETON_MARKER_H
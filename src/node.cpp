@@ -5,10 +5,22 @@ using namespace std;
 
 inline AbstractNode::~AbstractNode() { }
 
-AbstractType *NodeBlock::evaluate(Environment *env) {
-    AbstractType *last = nullptr;
-    for (auto const &node : *nodes) {
-        last = node->evaluate(env);
+Value NodeBlock::evaluate(Environment *env) {
+    return evaluateFrom(env, 0);
+}
+
+// The block stops at the first statement which does not complete normally, a collection at the
+// safepoint can fail as well.
+Value NodeBlock::evaluateFrom(Environment *env, unsigned index) {
+    Value last;
+    for (; index < nodes->size(); index++) {
+        if (!env->safepoint()) {
+            return Value();
+        }
+        last = (*nodes)[index]->evaluate(env);
+        if (env->abrupt()) {
+            return Value();
+        }
     }
     return last;
 }
@@ -22,9 +34,14 @@ NodeBlock::~NodeBlock() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeVariableDefinition::evaluate(Environment *env) {
-    env->setVariable(name, value->evaluate(env));
-    return nullptr;
+Value NodeVariableDefinition::evaluate(Environment *env) {
+    Value evaluated = value->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    env->site = &location;
+    env->setVariable(slot, evaluated);
+    return Value();
 }
 
 NodeVariableDefinition::~NodeVariableDefinition() {
@@ -33,21 +50,24 @@ NodeVariableDefinition::~NodeVariableDefinition() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeVariableName::evaluate(Environment *env) {
-    return env->getVariable(name);
+Value NodeVariableName::evaluate(Environment *env) {
+    return env->getVariable(slot);
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodePrint::evaluate(Environment *env) {
-    AbstractType *evaluated = value->evaluate(env);
-    cout << evaluated->toString();
+Value NodePrint::evaluate(Environment *env) {
+    Value evaluated = value->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    cout << evaluated.toString();
 
     if (breakLine) {
         cout << endl;
     }
 
-    return nullptr;
+    return Value();
 }
 
 NodePrint::~NodePrint() {
@@ -56,112 +76,341 @@ NodePrint::~NodePrint() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeBinaryOperator::evaluate(Environment *env) {
-    AbstractType *t1 = a->evaluate(env);
-    AbstractType *t2 = b->evaluate(env);
+// Operators on operands of known types. The switches are on the template argument, every instance keeps
+// only its own case.
+template <Operator Op>
+static Value intOperation(Environment *env, int t1, int t2) {
+    switch (Op) {
+        case ADD:
+            return env->makeInt(t1 + t2);
+        case SUB:
+            return env->makeInt(t1 - t2);
+        case MUL:
+            return env->makeInt(t1 * t2);
+        case DIV:
+            return env->makeInt(t1 / t2);
+        case MOD:
+            return env->makeInt(t1 % t2);
+        case EQ:
+            return env->makeBool(t1 == t2);
+        case NEQ:
+            return env->makeBool(t1 != t2);
+        case GT:
+            return env->makeBool(t1 > t2);
+        case LT:
+            return env->makeBool(t1 < t2);
+        case GTE:
+            return env->makeBool(t1 >= t2);
+        default:
+            return env->makeBool(t1 <= t2);
+    }
+}
 
-    if (t1->type() != t2->type()) {
-        runtimeError("Cannot apply operator for different types.");
+template <Operator Op>
+static Value charOperation(Environment *env, char t1, char t2) {
+    switch (Op) {
+        case EQ:
+            return env->makeBool(t1 == t2);
+        case NEQ:
+            return env->makeBool(t1 != t2);
+        case GT:
+            return env->makeBool(t1 > t2);
+        case LT:
+            return env->makeBool(t1 < t2);
+        case GTE:
+            return env->makeBool(t1 >= t2);
+        default:
+            return env->makeBool(t1 <= t2);
     }
+}
 
-    if (!t1->supportsOperator(op)) {
-        runtimeError("Operator not supported by type.");
+template <Operator Op>
+static Value boolOperation(Environment *env, bool t1, bool t2) {
+    switch (Op) {
+        case EQ:
+            return env->makeBool(t1 == t2);
+        case NEQ:
+            return env->makeBool(t1 != t2);
+        case AND:
+            return env->makeBool(t1 && t2);
+        default:
+            return env->makeBool(t1 || t2);
     }
+}
 
-    return t1->applyOperator(op, t2, env);
+Value NodeBinaryOperator::evaluate(Environment *env) {
+    return (this->*handler)(env);
 }
 
-NodeBinaryOperator::~NodeBinaryOperator() {
-    delete a;
-    delete b;
+// Operands of the same scalar type specialize the node when the type supports the operator, anything
+// else makes it generic.
+Value NodeBinaryOperator::evaluateUninitialized(Environment *env) {
+    Root t1(env, a->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value t2 = b->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    handler = t1.value.type() == t2.type() ? specialization(op, t2.type()) : nullptr;
+    if (handler == nullptr) {
+        handler = &NodeBinaryOperator::evaluateGeneric;
+    }
+    return apply(env, op, t1.value, t2, &location);
 }
 
-// -----------------------------------------------------------------------------
+Value NodeBinaryOperator::evaluateGeneric(Environment *env) {
+    Value t1 = a->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    return evaluateRest(env, t1);
+}
+
+Value NodeBinaryOperator::evaluateRest(Environment *env, Value t1) {
+    Root root(env, t1);
+    Value t2 = b->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    return apply(env, op, root.value, t2, &location);
+}
 
-AbstractType *NodeNotOperator::evaluate(Environment *env) {
-    AbstractType *t = a->evaluate(env);
+// The first operand is checked before the second one is evaluated, it is not a list then and needs no root.
+template <Type T, Operator Op>
+Value NodeBinaryOperator::evaluateScalar(Environment *env) {
+    Value t1 = a->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    if (t1.type() != T) {
+        deoptimize();
+        return evaluateRest(env, t1);
+    }
 
-    if (t->type() != BOOL) {
-        runtimeError("Using not operator with non-boolean variable.");
+    Value t2 = b->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    if (t2.type() != T) {
+        deoptimize();
+        return apply(env, op, t1, t2, &location);
     }
 
-    TypeBool *b = (TypeBool *) t;
-    return env->allocBool(!b->value());
+    switch (T) {
+        case INT:
+            return intOperation<Op>(env, t1.intValue(), t2.intValue());
+        case CHAR:
+            return charOperation<Op>(env, t1.charValue(), t2.charValue());
+        default:
+            return boolOperation<Op>(env, t1.boolValue(), t2.boolValue());
+    }
 }
 
-NodeNotOperator::~NodeNotOperator() {
+void NodeBinaryOperator::deoptimize() {
+    if (++deoptimizations < MaxDeoptimizations) {
+        handler = &NodeBinaryOperator::evaluateUninitialized;
+    } else {
+        handler = &NodeBinaryOperator::evaluateGeneric;
+    }
+}
+
+#define SPECIALIZATION(type, op) \
+    case op: \
+        return &NodeBinaryOperator::evaluateScalar<type, op>;
+
+// null when the type does not support the operator, === is cheap enough in the generic handler
+NodeBinaryOperator::Handler NodeBinaryOperator::specialization(Operator op, Type type) {
+    switch (type) {
+        case INT:
+            switch (op) {
+                SPECIALIZATION(INT, ADD)
+                SPECIALIZATION(INT, SUB)
+                SPECIALIZATION(INT, MUL)
+                SPECIALIZATION(INT, DIV)
+                SPECIALIZATION(INT, MOD)
+                SPECIALIZATION(INT, EQ)
+                SPECIALIZATION(INT, NEQ)
+                SPECIALIZATION(INT, GT)
+                SPECIALIZATION(INT, LT)
+                SPECIALIZATION(INT, GTE)
+                SPECIALIZATION(INT, LTE)
+                default:
+                    return nullptr;
+            }
+        case CHAR:
+            switch (op) {
+                SPECIALIZATION(CHAR, EQ)
+                SPECIALIZATION(CHAR, NEQ)
+                SPECIALIZATION(CHAR, GT)
+                SPECIALIZATION(CHAR, LT)
+                SPECIALIZATION(CHAR, GTE)
+                SPECIALIZATION(CHAR, LTE)
+                default:
+                    return nullptr;
+            }
+        case BOOL:
+            switch (op) {
+                SPECIALIZATION(BOOL, EQ)
+                SPECIALIZATION(BOOL, NEQ)
+                SPECIALIZATION(BOOL, AND)
+                SPECIALIZATION(BOOL, OR)
+                default:
+                    return nullptr;
+            }
+        default:
+            return nullptr;
+    }
+}
+
+#undef SPECIALIZATION
+
+// The first operand is updated in place if the operation allocates, so it has to be held by a root.
+Value NodeBinaryOperator::apply(Environment *env, Operator op, Value &t1, Value t2, SourceLocation *site) {
+    if (t1.type() != t2.type()) {
+        return env->fail("Cannot apply operator for different types.");
+    }
+
+    if (!t1.supportsOperator(op)) {
+        return env->fail("Operator not supported by type.");
+    }
+
+    env->site = site;
+    return t1.applyOperator(op, t2, env);
+}
+
+NodeBinaryOperator::~NodeBinaryOperator() {
     delete a;
+    delete b;
 }
 
 // -----------------------------------------------------------------------------
 
-NodeConstant::~NodeConstant() {
-    clean(value);
+template <Operator Op>
+Value NodeIntOperator<Op>::evaluate(Environment *env) {
+    int t1 = a->evaluate(env).intValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    int t2 = b->evaluate(env).intValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    return intOperation<Op>(env, t1, t2);
 }
 
-AbstractType *NodeConstant::evaluate(Environment *env) {
-    return alloc(value, env);
+template <Operator Op>
+Value NodeCharOperator<Op>::evaluate(Environment *env) {
+    char t1 = a->evaluate(env).charValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    char t2 = b->evaluate(env).charValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    return charOperation<Op>(env, t1, t2);
 }
 
-AbstractType *NodeConstant::alloc(AbstractType *type, Environment *env) {
-    AbstractType *evaluated = nullptr;
+template <Operator Op>
+Value NodeBoolOperator<Op>::evaluate(Environment *env) {
+    bool t1 = a->evaluate(env).boolValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    bool t2 = b->evaluate(env).boolValue();
+    if (env->abrupt()) {
+        return Value();
+    }
+    return boolOperation<Op>(env, t1, t2);
+}
 
-    switch (type->type()) {
-        case BOOL:
-            evaluated = env->allocBool(((TypeBool *) type)->value());
-            break;
-        case CHAR:
-            evaluated = env->allocChar(((TypeChar *) type)->value());
-            break;
-        case INT:
-            evaluated = env->allocInt(((TypeInt *) type)->value());
-            break;
-        case LIST: {
-            TypeList *originalList = (TypeList *) type;
-            vector<AbstractType *> *vectorCopy = new vector<AbstractType *>();
-
-            for (auto const &item : *originalList->value()) {
-                vectorCopy->push_back(alloc(item, env));
-            }
+template class NodeIntOperator<ADD>;
+template class NodeIntOperator<SUB>;
+template class NodeIntOperator<MUL>;
+template class NodeIntOperator<DIV>;
+template class NodeIntOperator<MOD>;
+template class NodeIntOperator<EQ>;
+template class NodeIntOperator<NEQ>;
+template class NodeIntOperator<GT>;
+template class NodeIntOperator<LT>;
+template class NodeIntOperator<GTE>;
+template class NodeIntOperator<LTE>;
+template class NodeCharOperator<EQ>;
+template class NodeCharOperator<NEQ>;
+template class NodeCharOperator<GT>;
+template class NodeCharOperator<LT>;
+template class NodeCharOperator<GTE>;
+template class NodeCharOperator<LTE>;
+template class NodeBoolOperator<EQ>;
+template class NodeBoolOperator<NEQ>;
+template class NodeBoolOperator<AND>;
+template class NodeBoolOperator<OR>;
 
-            evaluated = env->allocList(vectorCopy);
-        }
+// -----------------------------------------------------------------------------
+
+Value NodeNotOperator::evaluate(Environment *env) {
+    Value t = a->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    if (t.type() != BOOL) {
+        return env->fail("Using not operator with non-boolean variable.");
     }
 
-    return evaluated;
+    return env->makeBool(!t.boolValue());
 }
 
-void NodeConstant::clean(AbstractType *type) {
-    if (type->type() == LIST) {
-        TypeList *list = (TypeList *) type;
-        for (auto const &item : *list->value()) {
-            clean(item);
-        }
-    }
+NodeNotOperator::~NodeNotOperator() {
+    delete a;
+}
+
+// -----------------------------------------------------------------------------
 
-    delete type;
+Value NodeConstant::evaluate(Environment *env) {
+    return value;
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeWhile::evaluate(Environment *env) {
+Value NodeWhile::evaluate(Environment *env) {
     for (; ;) {
-        AbstractType *evaluated = condition->evaluate(env);
+        if (!env->safepoint()) {
+            return Value();
+        }
+
+        if (env->jit != nullptr && hotness++ >= Jit::HotLoop) {
+            JitResult result = env->jit->run(this, &jitLoop, env);
+            if (result == JIT_FINISHED) {
+                return Value();
+            } else if (result == JIT_CONTINUE) {
+                continue;
+            }
+        }
 
-        if (evaluated->type() != BOOL) {
-            runtimeError("Cannot use non-bool value for condition.");
+        Value evaluated = condition->evaluate(env);
+        if (env->abrupt()) {
+            return Value();
         }
 
-        TypeBool *evaluatedBool = (TypeBool *) evaluated;
+        if (evaluated.type() != BOOL) {
+            return env->fail("Cannot use non-bool value for condition.");
+        }
 
-        if (!evaluatedBool->value()) {
-            return nullptr;
+        if (!evaluated.boolValue()) {
+            return Value();
         }
 
-        try {
-            block->evaluate(env);
-        } catch (NodeBreak::BreakException e) {
-            return nullptr;
+        block->evaluate(env);
+        if (env->completion == BREAK_COMPLETION) {
+            env->completion = NORMAL_COMPLETION;
+            return Value();
+        }
+        if (env->abrupt()) {
+            return Value();
         }
     }
 }
@@ -173,22 +422,23 @@ NodeWhile::~NodeWhile() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeIfElse::evaluate(Environment *env) {
-    AbstractType *evaluated = condition->evaluate(env);
-
-    if (evaluated->type() != BOOL) {
-        runtimeError("Cannot use non-bool value for condition.");
+Value NodeIfElse::evaluate(Environment *env) {
+    Value evaluated = condition->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
     }
 
-    TypeBool *evaluatedBool = (TypeBool *) evaluated;
+    if (evaluated.type() != BOOL) {
+        return env->fail("Cannot use non-bool value for condition.");
+    }
 
-    if (evaluatedBool->value()) {
+    if (evaluated.boolValue()) {
         ifBlock->evaluate(env);
     } else {
         elseBlock->evaluate(env);
     }
 
-    return nullptr;
+    return Value();
 }
 
 NodeIfElse::~NodeIfElse() {
@@ -199,39 +449,35 @@ NodeIfElse::~NodeIfElse() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeScanInt::evaluate(Environment *env) {
+Value NodeScanInt::evaluate(Environment *env) {
     int number;
     cin >> number;
-    return env->allocInt(number);
+    return env->makeInt(number);
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeScanChar::evaluate(Environment *env) {
+Value NodeScanChar::evaluate(Environment *env) {
     char character;
     cin >> character;
-    return env->allocChar(character);
+    return env->makeChar(character);
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeScanString::evaluate(Environment *env) {
+Value NodeScanString::evaluate(Environment *env) {
     string input;
     cin >> input;
 
-    vector<AbstractType *> *list = new vector<AbstractType *>();
-
-    for (char &c : input) {
-        list->push_back(env->allocChar(c));
-    }
-
-    return env->allocList(list);
+    env->site = &location;
+    return Value::fromList(env->allocList(env->makeString(input)));
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeBreak::evaluate(Environment *env) {
-    throw breakException;
+Value NodeBreak::evaluate(Environment *env) {
+    env->completion = BREAK_COMPLETION;
+    return Value();
 }
 
 // -----------------------------------------------------------------------------
@@ -242,16 +488,19 @@ NodeLen::~NodeLen() {
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeLen::evaluate(Environment *env) {
-    AbstractType *result = expression->evaluate(env);
+Value NodeLen::evaluate(Environment *env) {
+    Value result = expression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
 
-    if (result->type() != LIST) {
-        runtimeError("len can be only used with lists.");
+    if (result.type() != LIST) {
+        return env->fail("len can be only used with lists.");
     }
 
-    TypeList *list = (TypeList *) result;
+    TypeList *list = result.listValue();
 
-    return env->allocInt((int) list->value()->size());
+    return env->makeInt((int) list->size());
 }
 
 // -----------------------------------------------------------------------------
@@ -261,17 +510,31 @@ NodeAppend::~NodeAppend() {
     delete valueExpression;
 }
 
-AbstractType *NodeAppend::evaluate(Environment *env) {
-    AbstractType *listResult = listExpression->evaluate(env);
-    AbstractType *valueResult = valueExpression->evaluate(env);
+Value NodeAppend::evaluate(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Root valueResult(env, valueExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
 
-    if (listResult->type() != LIST) {
-        runtimeError("First argument of append must be list.");
+    if (listResult.value.type() != LIST) {
+        return env->fail("First argument of append must be list.");
     }
 
-    TypeList *list = (TypeList *) listResult;
-    list->value()->push_back(valueResult);
-    return nullptr;
+    env->site = &location;
+    listResult.value = env->materialize(listResult.value);
+    valueResult.value = env->materialize(valueResult.value);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    TypeList *list = listResult.value.listValue();
+    list->append(valueResult.value);
+    env->writeBarrier(list, list->size() - 1, valueResult.value);
+    return Value();
 }
 
 // -----------------------------------------------------------------------------
@@ -281,44 +544,199 @@ NodeGet::~NodeGet() {
     delete indexExpression;
 }
 
-AbstractType *NodeGet::evaluate(Environment *env) {
-    AbstractType *listResult = listExpression->evaluate(env);
-    AbstractType *indexResult = indexExpression->evaluate(env);
+Value NodeGet::evaluate(Environment *env) {
+    return (this->*handler)(env);
+}
+
+// A packed list of ints or chars specializes the node to read its elements directly.
+Value NodeGet::evaluateUninitialized(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    handler = &NodeGet::evaluateGeneric;
+    if (listResult.value.isList() && indexResult.type() == INT) {
+        ListKind kind = listResult.value.listValue()->kind();
+        if (kind == INT_LIST) {
+            handler = &NodeGet::evaluatePacked<INT_LIST>;
+        } else if (kind == STRING_LIST) {
+            handler = &NodeGet::evaluatePacked<STRING_LIST>;
+        }
+    }
+    return get(env, listResult.value, indexResult);
+}
+
+Value NodeGet::evaluateGeneric(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    return get(env, listResult.value, indexResult);
+}
+
+template <ListKind Kind>
+Value NodeGet::evaluatePacked(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    if (!listResult.value.isList() || indexResult.type() != INT || listResult.value.listValue()->kind() != Kind) {
+        deoptimize();
+        return get(env, listResult.value, indexResult);
+    }
 
-    if (listResult->type() != LIST) {
-        runtimeError("First argument of append must be list.");
+    TypeList *list = listResult.value.listValue();
+    if (Kind == INT_LIST) {
+        return list->intAt((unsigned) indexResult.intValue());
     }
+    return list->charAt((unsigned) indexResult.intValue());
+}
 
-    if (indexResult->type() != INT) {
-        runtimeError("Second argument of get must be int.");
+Value NodeGet::get(Environment *env, Value listResult, Value indexResult) {
+    if (listResult.type() != LIST) {
+        return env->fail("First argument of append must be list.");
     }
 
-    TypeList *list = (TypeList *) listResult;
-    TypeInt *index = (TypeInt *) indexResult;
+    if (indexResult.type() != INT) {
+        return env->fail("Second argument of get must be int.");
+    }
+
+    TypeList *list = listResult.listValue();
+
+    return list->get((unsigned) indexResult.intValue());
+}
 
-    return list->value()->at((unsigned) index->value());
+void NodeGet::deoptimize() {
+    if (++deoptimizations < MaxDeoptimizations) {
+        handler = &NodeGet::evaluateUninitialized;
+    } else {
+        handler = &NodeGet::evaluateGeneric;
+    }
 }
 
 // -----------------------------------------------------------------------------
 
-AbstractType *NodeSet::evaluate(Environment *env) {
-    AbstractType *listResult = listExpression->evaluate(env);
-    AbstractType *indexResult = indexExpression->evaluate(env);
-    AbstractType *valueResult = valueExpression->evaluate(env);
+Value NodeSet::evaluate(Environment *env) {
+    return (this->*handler)(env);
+}
 
-    if (listResult->type() != LIST) {
-        runtimeError("First argument of set must be list.");
+// An int stored into a packed list of ints or a char into a packed list of chars specializes the node
+// to write the element directly. Scalars need neither materializing nor the write barrier.
+Value NodeSet::evaluateUninitialized(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    Root valueResult(env, valueExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
     }
 
-    if (indexResult->type() != INT) {
-        runtimeError("Second argument of set must be int.");
+    handler = &NodeSet::evaluateGeneric;
+    if (listResult.value.isList() && !listResult.value.listValue()->isConstant() && indexResult.type() == INT) {
+        ListKind kind = listResult.value.listValue()->kind();
+        if (kind == INT_LIST && valueResult.value.type() == INT) {
+            handler = &NodeSet::evaluatePacked<INT_LIST>;
+        } else if (kind == STRING_LIST && valueResult.value.type() == CHAR) {
+            handler = &NodeSet::evaluatePacked<STRING_LIST>;
+        }
     }
+    return set(env, listResult.value, indexResult, valueResult.value);
+}
 
-    TypeList *list = (TypeList *) listResult;
-    TypeInt *index = (TypeInt *) indexResult;
+Value NodeSet::evaluateGeneric(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    Root valueResult(env, valueExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    return set(env, listResult.value, indexResult, valueResult.value);
+}
 
-    (*list->value())[index->value()] = valueResult;
-    return nullptr;
+template <ListKind Kind>
+Value NodeSet::evaluatePacked(Environment *env) {
+    Root listResult(env, listExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+    Value indexResult = indexExpression->evaluate(env);
+    if (env->abrupt()) {
+        return Value();
+    }
+    Root valueResult(env, valueExpression->evaluate(env));
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    Value list = listResult.value;
+    Type valueType = Kind == INT_LIST ? INT : CHAR;
+    if (!list.isList() || list.listValue()->isConstant() || list.listValue()->kind() != Kind ||
+        indexResult.type() != INT || valueResult.value.type() != valueType) {
+        deoptimize();
+        return set(env, listResult.value, indexResult, valueResult.value);
+    }
+
+    if (Kind == INT_LIST) {
+        list.listValue()->setInt((unsigned) indexResult.intValue(), valueResult.value);
+    } else {
+        list.listValue()->setChar((unsigned) indexResult.intValue(), valueResult.value);
+    }
+    return Value();
+}
+
+Value NodeSet::set(Environment *env, Value &listResult, Value indexResult, Value &valueResult) {
+    if (listResult.type() != LIST) {
+        return env->fail("First argument of set must be list.");
+    }
+
+    if (indexResult.type() != INT) {
+        return env->fail("Second argument of set must be int.");
+    }
+
+    env->site = &location;
+    listResult = env->materialize(listResult);
+    valueResult = env->materialize(valueResult);
+    if (env->abrupt()) {
+        return Value();
+    }
+
+    TypeList *list = listResult.listValue();
+    list->set((unsigned) indexResult.intValue(), valueResult);
+    env->writeBarrier(list, (unsigned) indexResult.intValue(), valueResult);
+    return Value();
+}
+
+void NodeSet::deoptimize() {
+    if (++deoptimizations < MaxDeoptimizations) {
+        handler = &NodeSet::evaluateUninitialized;
+    } else {
+        handler = &NodeSet::evaluateGeneric;
+    }
 }
 
 NodeSet::~NodeSet() {
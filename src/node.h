@@ -6,14 +6,57 @@
 #include <exception>
 #include <vector>
 
+#include "closure.h"
 #include "type.h"
+#include "type_inference.h"
 
+class AstDumper;
+
+class CEmitter;
+
+class Compiler;
+
+class JitCompiler;
+
+class Optimizer;
+
+struct JitLoop;
 
 class AbstractNode {
 public:
-    virtual AbstractType *evaluate(Environment *env) = 0;
+    virtual Value evaluate(Environment *env) = 0;
+
+    // emits the bytecode of the node and returns the register of its value, see Compiler
+    virtual unsigned compile(Compiler *compiler) = 0;
+
+    // returns the node prepared for the closure engine
+    virtual Closure close() = 0;
+
+    // emits the C code of the node and returns the C expression of its value, see CEmitter
+    virtual std::string emitC(CEmitter *emitter) = 0;
+
+    // infers the types of the value of the node into types and returns the node to use in its place,
+    // see TypeInference
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types) = 0;
+
+    // simplifies the node whose value is used as given and returns the node to use in its place, see Optimizer
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use) = 0;
+
+    virtual void dump(AstDumper *dumper) = 0;
+
+    virtual Test test();
+
+    // emits native code of the node for a hot loop, false when the JIT leaves it to the interpreter
+    virtual bool jit(JitCompiler *compiler);
+
+    virtual bool jitCondition(JitCompiler *compiler, unsigned falseLabel);
 
     virtual ~AbstractNode() = 0;
+
+    SourceLocation location;
+
+    // failed guards after which a node that specializes itself stays generic
+    static const unsigned MaxDeoptimizations = 8;
 };
 
 // -----------------------------------------------------------------------------
@@ -24,7 +67,26 @@ public:
 
     ~NodeBlock();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    // runs the statements from the index on
+    Value evaluateFrom(Environment *env, unsigned index);
+
+    unsigned size() { return (unsigned) nodes->size(); };
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     std::vector<AbstractNode *> *nodes;
@@ -34,14 +96,28 @@ private:
 
 class NodeVariableDefinition : public AbstractNode {
 public:
-    NodeVariableDefinition(std::string name, AbstractNode *value) : name(name), value(value) { };
+    NodeVariableDefinition(unsigned slot, AbstractNode *value) : slot(slot), value(value) { };
 
     ~NodeVariableDefinition();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
-    std::string name;
+    unsigned slot;
     AbstractNode *value;
 };
 
@@ -49,12 +125,28 @@ private:
 
 class NodeVariableName : public AbstractNode {
 public:
-    NodeVariableName(std::string name) : name(name) { };
+    NodeVariableName(unsigned slot) : slot(slot) { };
+
+    unsigned getSlot() { return slot; };
+
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
-    std::string name;
+    unsigned slot;
 };
 
 // -----------------------------------------------------------------------------
@@ -65,7 +157,21 @@ public:
 
     ~NodePrint();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     AbstractNode *value;
@@ -80,12 +186,95 @@ public:
 
     ~NodeBinaryOperator();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
 
-private:
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
+
+    virtual bool jitCondition(JitCompiler *compiler, unsigned falseLabel);
+
+    virtual Test test();
+
+    static Value apply(Environment *env, Operator op, Value &t1, Value t2, SourceLocation *site);
+
+protected:
     Operator op;
     AbstractNode *a;
     AbstractNode *b;
+
+    // prints the operator with the types of its operands, see NodeIntOperator
+    void dumpOperator(AstDumper *dumper, const std::string &operands);
+
+    friend class Optimizer;
+
+    friend class TypeInference;
+
+private:
+    // The node rewrites itself by replacing the handler which evaluates it. The first evaluation
+    // observes the types of the operands, a guard of a specialized handler which fails goes back to it.
+    typedef Value (NodeBinaryOperator::*Handler)(Environment *env);
+
+    Value evaluateUninitialized(Environment *env);
+
+    Value evaluateGeneric(Environment *env);
+
+    // evaluates the second operand and applies the operator with the checks
+    Value evaluateRest(Environment *env, Value t1);
+
+    template <Type T, Operator Op>
+    Value evaluateScalar(Environment *env);
+
+    void deoptimize();
+
+    static Handler specialization(Operator op, Type type);
+
+    Handler handler = &NodeBinaryOperator::evaluateUninitialized;
+    unsigned deoptimizations = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+// Operators on operands which are known to be ints, chars or bools, see TypeInference. They evaluate
+// the operands without checking their types, the other engines compile them as generic operators.
+template <Operator Op>
+class NodeIntOperator : public NodeBinaryOperator {
+public:
+    NodeIntOperator(AbstractNode *a, AbstractNode *b) : NodeBinaryOperator(Op, a, b) { };
+
+    virtual Value evaluate(Environment *env);
+
+    virtual void dump(AstDumper *dumper) { dumpOperator(dumper, "int "); };
+};
+
+template <Operator Op>
+class NodeCharOperator : public NodeBinaryOperator {
+public:
+    NodeCharOperator(AbstractNode *a, AbstractNode *b) : NodeBinaryOperator(Op, a, b) { };
+
+    virtual Value evaluate(Environment *env);
+
+    virtual void dump(AstDumper *dumper) { dumpOperator(dumper, "char "); };
+};
+
+template <Operator Op>
+class NodeBoolOperator : public NodeBinaryOperator {
+public:
+    NodeBoolOperator(AbstractNode *a, AbstractNode *b) : NodeBinaryOperator(Op, a, b) { };
+
+    virtual Value evaluate(Environment *env);
+
+    virtual void dump(AstDumper *dumper) { dumpOperator(dumper, "bool "); };
 };
 
 // -----------------------------------------------------------------------------
@@ -96,7 +285,23 @@ public:
 
     ~NodeNotOperator();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
+
+    virtual Test test();
 
 private:
     AbstractNode *a;
@@ -106,18 +311,28 @@ private:
 
 class NodeConstant : public AbstractNode {
 public:
-    NodeConstant(AbstractType *value) : value(value) { };
+    NodeConstant(Value value) : value(value) { };
 
-    ~NodeConstant();
+    Value getValue() { return value; };
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
 
-private:
-    AbstractType *alloc(AbstractType *type, Environment *env);
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
 
-    void clean(AbstractType *type);
+    virtual std::string emitC(CEmitter *emitter);
 
-    AbstractType *value;
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
+
+private:
+    Value value;
 };
 
 // -----------------------------------------------------------------------------
@@ -128,11 +343,27 @@ public:
 
     ~NodeWhile();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     AbstractNode *condition;
     NodeBlock *block;
+    unsigned hotness = 0;  // iterations run by the interpreter, see Jit
+    JitLoop *jitLoop = nullptr;
 };
 
 // -----------------------------------------------------------------------------
@@ -145,7 +376,21 @@ public:
 
     ~NodeIfElse();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     AbstractNode *condition;
@@ -157,31 +402,82 @@ private:
 
 class NodeScanInt : public AbstractNode {
 public:
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
 };
 
 // -----------------------------------------------------------------------------
 
 class NodeScanChar : public AbstractNode {
 public:
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
 };
 
 // -----------------------------------------------------------------------------
 
 class NodeScanString : public AbstractNode {
 public:
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
 };
 
 // -----------------------------------------------------------------------------
 
 class NodeBreak : public AbstractNode {
 public:
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
 
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
+
+    // thrown only for a break outside of any loop, which ends the program as it always did
     class BreakException : public std::exception {
-    } breakException;
+    };
 };
 
 // -----------------------------------------------------------------------------
@@ -192,7 +488,21 @@ public:
 
     ~NodeLen();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     AbstractNode *expression;
@@ -207,7 +517,21 @@ public:
 
     ~NodeAppend();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
     AbstractNode *listExpression;
@@ -223,11 +547,41 @@ public :
 
     ~NodeGet();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
+    // specializes itself to packed lists of ints or chars like NodeBinaryOperator
+    typedef Value (NodeGet::*Handler)(Environment *env);
+
+    Value evaluateUninitialized(Environment *env);
+
+    Value evaluateGeneric(Environment *env);
+
+    template <ListKind Kind>
+    Value evaluatePacked(Environment *env);
+
+    Value get(Environment *env, Value listResult, Value indexResult);
+
+    void deoptimize();
+
     AbstractNode *listExpression;
     AbstractNode *indexExpression;
+    Handler handler = &NodeGet::evaluateUninitialized;
+    unsigned deoptimizations = 0;
 };
 
 // -----------------------------------------------------------------------------
@@ -239,12 +593,43 @@ public :
 
     ~NodeSet();
 
-    virtual AbstractType *evaluate(Environment *env);
+    virtual Value evaluate(Environment *env);
+
+    virtual unsigned compile(Compiler *compiler);
+
+    virtual Closure close();
+
+    virtual std::string emitC(CEmitter *emitter);
+
+    virtual AbstractNode *infer(TypeInference *inference, TypeSet *types);
+
+    virtual AbstractNode *optimize(Optimizer *optimizer, ValueUse use);
+
+    virtual void dump(AstDumper *dumper);
+
+    virtual bool jit(JitCompiler *compiler);
 
 private:
+    // specializes itself to packed lists of ints or chars like NodeBinaryOperator
+    typedef Value (NodeSet::*Handler)(Environment *env);
+
+    Value evaluateUninitialized(Environment *env);
+
+    Value evaluateGeneric(Environment *env);
+
+    template <ListKind Kind>
+    Value evaluatePacked(Environment *env);
+
+    // the list and the value are held by roots
+    Value set(Environment *env, Value &listResult, Value indexResult, Value &valueResult);
+
+    void deoptimize();
+
     AbstractNode *listExpression;
     AbstractNode *indexExpression;
     AbstractNode *valueExpression;
+    Handler handler = &NodeSet::evaluateUninitialized;
+    unsigned deoptimizations = 0;
 };
 
 
@@ -0,0 +1,378 @@
+#include <climits>
+
+#include "node.h"
+#include "optimizer.h"
+
+using namespace std;
+
+AbstractNode *Optimizer::run(AbstractNode *root) {
+    return root->optimize(this, VALUE_USED);
+}
+
+// Wraps around on overflow like the interpreter. A zero divisor and INT_MIN / -1 trap, they stay.
+static bool foldInt(Operator op, int t1, int t2, int *result) {
+    unsigned u1 = (unsigned) t1;
+    unsigned u2 = (unsigned) t2;
+    switch (op) {
+        case ADD:
+            *result = (int) (u1 + u2);
+            return true;
+        case SUB:
+            *result = (int) (u1 - u2);
+            return true;
+        case MUL:
+            *result = (int) (u1 * u2);
+            return true;
+        case DIV:
+        case MOD:
+            if (t2 == 0 || (t1 == INT_MIN && t2 == -1)) {
+                return false;
+            }
+            *result = op == DIV ? t1 / t2 : t1 % t2;
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <typename T>
+static bool compare(Operator op, T t1, T t2, bool *result) {
+    switch (op) {
+        case EQ:
+            *result = t1 == t2;
+            return true;
+        case NEQ:
+            *result = t1 != t2;
+            return true;
+        case GT:
+            *result = t1 > t2;
+            return true;
+        case LT:
+            *result = t1 < t2;
+            return true;
+        case GTE:
+            *result = t1 >= t2;
+            return true;
+        case LTE:
+            *result = t1 <= t2;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static string chars(TypeList *list) {
+    string chars;
+    for (unsigned i = 0; i < list->size(); i++) {
+        chars += list->get(i).charValue();
+    }
+    return chars;
+}
+
+// === compares identities, the operands of different types and the operators a type does not support fail,
+// all of them are left to run time.
+bool Optimizer::fold(Operator op, Value a, Value b, Value *result) {
+    if (op == EQEQ || a.type() != b.type()) {
+        return false;
+    }
+
+    bool boolResult;
+    switch (a.type()) {
+        case INT: {
+            int intResult;
+            if (foldInt(op, a.intValue(), b.intValue(), &intResult)) {
+                *result = constants->addInt(intResult);
+                return true;
+            }
+            if (compare(op, a.intValue(), b.intValue(), &boolResult)) {
+                *result = constants->addBool(boolResult);
+                return true;
+            }
+            return false;
+        }
+        case CHAR:
+            if (compare(op, a.charValue(), b.charValue(), &boolResult)) {
+                *result = constants->addBool(boolResult);
+                return true;
+            }
+            return false;
+        case BOOL:
+            switch (op) {
+                case EQ:
+                    *result = constants->addBool(a.boolValue() == b.boolValue());
+                    return true;
+                case NEQ:
+                    *result = constants->addBool(a.boolValue() != b.boolValue());
+                    return true;
+                case AND:
+                    *result = constants->addBool(a.boolValue() && b.boolValue());
+                    return true;
+                case OR:
+                    *result = constants->addBool(a.boolValue() || b.boolValue());
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            // list literals are strings, only their concatenation is folded
+            if (op == ADD && !a.isNull() && !b.isNull()) {
+                *result = constants->addString(chars(a.listValue()) + chars(b.listValue()));
+                return true;
+            }
+            return false;
+    }
+}
+
+bool Optimizer::isFreshInt(AbstractNode *node) {
+    if (dynamic_cast<NodeLen *>(node) != nullptr || dynamic_cast<NodeScanInt *>(node) != nullptr) {
+        return true;
+    }
+    NodeBinaryOperator *binary = dynamic_cast<NodeBinaryOperator *>(node);
+    if (binary == nullptr) {
+        return false;
+    }
+    switch (binary->op) {
+        case ADD:
+            return isFreshInt(binary->a) && isFreshInt(binary->b);
+        case SUB:
+        case MUL:
+        case DIV:
+        case MOD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Optimizer::isFreshBool(AbstractNode *node) {
+    if (dynamic_cast<NodeNotOperator *>(node) != nullptr) {
+        return true;
+    }
+    NodeBinaryOperator *binary = dynamic_cast<NodeBinaryOperator *>(node);
+    return binary != nullptr && binary->op != ADD && binary->op != SUB && binary->op != MUL && binary->op != DIV &&
+           binary->op != MOD;
+}
+
+bool Optimizer::isConstant(AbstractNode *node, Value *value) {
+    NodeConstant *constant = dynamic_cast<NodeConstant *>(node);
+    if (constant == nullptr) {
+        return false;
+    }
+    *value = constant->getValue();
+    return true;
+}
+
+bool Optimizer::isConstant(AbstractNode *node, int value) {
+    Value constant;
+    return isConstant(node, &constant) && constant.type() == INT && constant.intValue() == value;
+}
+
+bool Optimizer::isConstant(AbstractNode *node, bool value) {
+    Value constant;
+    return isConstant(node, &constant) && constant.type() == BOOL && constant.boolValue() == value;
+}
+
+// -- Nodes --------------------------------------------------------------------
+
+// Blocks returned by the statements are spliced in, so dead branches and loops leave nothing behind.
+// Constants are dropped as statements and so is everything after a break. The value of the last statement
+// of the program is printed by the console, it is optimized as used.
+AbstractNode *NodeBlock::optimize(Optimizer *optimizer, ValueUse use) {
+    vector<AbstractNode *> *optimized = new vector<AbstractNode *>();
+    for (size_t i = 0; i < nodes->size(); i++) {
+        bool last = i + 1 == nodes->size();
+        AbstractNode *node = (*nodes)[i]->optimize(optimizer, last ? use : VALUE_DISCARDED);
+
+        NodeBlock *block = dynamic_cast<NodeBlock *>(node);
+        Value value;
+        if (block != nullptr) {
+            optimized->insert(optimized->end(), block->nodes->begin(), block->nodes->end());
+            block->nodes->clear();
+            delete block;
+        } else if (Optimizer::isConstant(node, &value) && (!last || use == VALUE_DISCARDED)) {
+            delete node;
+        } else {
+            optimized->push_back(node);
+        }
+
+        if (!optimized->empty() && dynamic_cast<NodeBreak *>(optimized->back()) != nullptr) {
+            for (i++; i < nodes->size(); i++) {
+                delete (*nodes)[i];
+            }
+        }
+    }
+    delete nodes;
+    nodes = optimized;
+    return this;
+}
+
+AbstractNode *NodeVariableDefinition::optimize(Optimizer *optimizer, ValueUse use) {
+    value = value->optimize(optimizer, IDENTITY_USED);
+    return this;
+}
+
+AbstractNode *NodeVariableName::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+AbstractNode *NodePrint::optimize(Optimizer *optimizer, ValueUse use) {
+    value = value->optimize(optimizer, VALUE_USED);
+    return this;
+}
+
+// A simplified operator is replaced by its other operand, only when that is a new int or bool, so the
+// result has its own identity and fails on the same operands as before.
+AbstractNode *NodeBinaryOperator::optimize(Optimizer *optimizer, ValueUse use) {
+    a = a->optimize(optimizer, op == EQEQ ? IDENTITY_USED : VALUE_USED);
+    b = b->optimize(optimizer, op == EQEQ ? IDENTITY_USED : VALUE_USED);
+
+    Value t1, t2, result;
+    if (use != IDENTITY_USED && Optimizer::isConstant(a, &t1) && Optimizer::isConstant(b, &t2) &&
+        optimizer->fold(op, t1, t2, &result)) {
+        NodeConstant *constant = new NodeConstant(result);
+        constant->location = location;
+        delete this;
+        return constant;
+    }
+
+    AbstractNode **kept = nullptr;
+    switch (op) {
+        case ADD:
+            if (Optimizer::isConstant(a, 0) && Optimizer::isFreshInt(b)) {
+                kept = &b;
+            } else if (Optimizer::isConstant(b, 0) && Optimizer::isFreshInt(a)) {
+                kept = &a;
+            }
+            break;
+        case SUB:
+        case DIV:
+            if (Optimizer::isConstant(b, op == SUB ? 0 : 1) && Optimizer::isFreshInt(a)) {
+                kept = &a;
+            }
+            break;
+        case MUL:
+            if (Optimizer::isConstant(a, 1) && Optimizer::isFreshInt(b)) {
+                kept = &b;
+            } else if (Optimizer::isConstant(b, 1) && Optimizer::isFreshInt(a)) {
+                kept = &a;
+            }
+            break;
+        case AND:
+        case OR:
+            if (Optimizer::isConstant(a, op == AND) && Optimizer::isFreshBool(b)) {
+                kept = &b;
+            } else if (Optimizer::isConstant(b, op == AND) && Optimizer::isFreshBool(a)) {
+                kept = &a;
+            }
+            break;
+        default:
+            break;
+    }
+    if (kept == nullptr) {
+        return this;
+    }
+
+    AbstractNode *operand = *kept;
+    *kept = nullptr;
+    delete this;
+    return operand;
+}
+
+AbstractNode *NodeNotOperator::optimize(Optimizer *optimizer, ValueUse use) {
+    a = a->optimize(optimizer, VALUE_USED);
+
+    Value value;
+    if (use != IDENTITY_USED && Optimizer::isConstant(a, &value) && value.type() == BOOL) {
+        NodeConstant *constant = new NodeConstant(optimizer->constant(!value.boolValue()));
+        constant->location = location;
+        delete this;
+        return constant;
+    }
+
+    NodeNotOperator *inner = dynamic_cast<NodeNotOperator *>(a);
+    if (inner != nullptr && Optimizer::isFreshBool(inner->a)) {
+        AbstractNode *operand = inner->a;
+        inner->a = nullptr;
+        delete this;
+        return operand;
+    }
+    return this;
+}
+
+AbstractNode *NodeConstant::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+// The statements are optimized in any case, a loop which never runs becomes an empty block.
+AbstractNode *NodeWhile::optimize(Optimizer *optimizer, ValueUse use) {
+    condition = condition->optimize(optimizer, VALUE_USED);
+    block->optimize(optimizer, VALUE_DISCARDED);
+
+    if (use == VALUE_DISCARDED && Optimizer::isConstant(condition, false)) {
+        delete this;
+        return new NodeBlock(new vector<AbstractNode *>());
+    }
+    return this;
+}
+
+AbstractNode *NodeIfElse::optimize(Optimizer *optimizer, ValueUse use) {
+    condition = condition->optimize(optimizer, VALUE_USED);
+    ifBlock->optimize(optimizer, VALUE_DISCARDED);
+    elseBlock->optimize(optimizer, VALUE_DISCARDED);
+
+    Value value;
+    if (use != VALUE_DISCARDED || !Optimizer::isConstant(condition, &value) || value.type() != BOOL) {
+        return this;
+    }
+
+    NodeBlock *taken;
+    if (value.boolValue()) {
+        taken = ifBlock;
+        ifBlock = nullptr;
+    } else {
+        taken = elseBlock;
+        elseBlock = nullptr;
+    }
+    delete this;
+    return taken;
+}
+
+AbstractNode *NodeScanInt::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+AbstractNode *NodeScanChar::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+AbstractNode *NodeScanString::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+AbstractNode *NodeBreak::optimize(Optimizer *optimizer, ValueUse use) {
+    return this;
+}
+
+AbstractNode *NodeLen::optimize(Optimizer *optimizer, ValueUse use) {
+    expression = expression->optimize(optimizer, VALUE_USED);
+    return this;
+}
+
+AbstractNode *NodeAppend::optimize(Optimizer *optimizer, ValueUse use) {
+    listExpression = listExpression->optimize(optimizer, VALUE_USED);
+    valueExpression = valueExpression->optimize(optimizer, IDENTITY_USED);
+    return this;
+}
+
+AbstractNode *NodeGet::optimize(Optimizer *optimizer, ValueUse use) {
+    listExpression = listExpression->optimize(optimizer, VALUE_USED);
+    indexExpression = indexExpression->optimize(optimizer, VALUE_USED);
+    return this;
+}
+
+AbstractNode *NodeSet::optimize(Optimizer *optimizer, ValueUse use) {
+    listExpression = listExpression->optimize(optimizer, VALUE_USED);
+    indexExpression = indexExpression->optimize(optimizer, VALUE_USED);
+    valueExpression = valueExpression->optimize(optimizer, IDENTITY_USED);
+    return this;
+}
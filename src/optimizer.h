@@ -0,0 +1,41 @@
+#ifndef TEETON_OPTIMIZER_H
+#define TEETON_OPTIMIZER_H
+
+#include "constant_pool.h"
+#include "enums.h"
+#include "type.h"
+
+class AbstractNode;
+
+// Rewrites the tree before it runs. Operators on constants are folded into constants of the pool, identities
+// like x + 0 or b && True are simplified, if with a constant condition is replaced by the taken block, while (False)
+// and statements after break are removed. Nothing which may fail at run time is folded or removed, so errors are
+// reported as before, and operators whose identity is used stay, see ValueUse.
+class Optimizer {
+public:
+    Optimizer(ConstantPool *constants) : constants(constants) { };
+
+    // returns the root to evaluate instead
+    AbstractNode *run(AbstractNode *root);
+
+    // computes the operator on constant operands, false when it is left to run time
+    bool fold(Operator op, Value a, Value b, Value *result);
+
+    Value constant(bool value) { return constants->addBool(value); };
+
+    // the node evaluates to a new int or bool without side effects of its own
+    static bool isFreshInt(AbstractNode *node);
+
+    static bool isFreshBool(AbstractNode *node);
+
+    static bool isConstant(AbstractNode *node, Value *value);
+
+    static bool isConstant(AbstractNode *node, int value);
+
+    static bool isConstant(AbstractNode *node, bool value);
+
+private:
+    ConstantPool *constants;
+};
+
+#endif //TEETON_OPTIMIZER_H
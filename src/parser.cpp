@@ -12,6 +12,11 @@ const vector<string> Parser::OperatorPriority6({"&&"});
 const vector<string> Parser::OperatorPriority7({"||"});
 
 
+Parser::~Parser() {
+    delete constants;
+    delete symbols;
+}
+
 AbstractNode *Parser::parse(string source) {
     Scanner *scanner = new Scanner(source);
     lexer = new Lexer(scanner);
@@ -23,6 +28,13 @@ AbstractNode *Parser::parse(string source) {
     return result;
 }
 
+AbstractNode *Parser::locate(AbstractNode *node, Token *token) {
+    node->location.lineIndex = token->lineIndex;
+    node->location.colIndex = token->colIndex;
+    node->location.node = token->cargo;
+    return node;
+}
+
 void Parser::assertToken(Token *token, string expectedType, string expectedCargo) {
     if (token->tokenType != expectedType || (expectedCargo.length() > 0 && token->cargo != expectedCargo)) {
         ostringstream os;
@@ -50,14 +62,14 @@ NodeBlock *Parser::parseBlock() {
     while (token->tokenType != TOKEN_EOF && token->cargo != "}") {
         if (token->tokenType == TOKEN_SYMBOL) {
             if (token->cargo == "print" || token->cargo == "println") {
-                nodes->push_back(parsePrint(token->cargo == "println"));
+                nodes->push_back(locate(parsePrint(token->cargo == "println"), token));
             } else if (token->cargo == "while") {
-                nodes->push_back(parseWhile());
+                nodes->push_back(locate(parseWhile(), token));
             } else if (token->cargo == "if") {
-                nodes->push_back(parseIfElse());
+                nodes->push_back(locate(parseIfElse(), token));
             } else if (token->cargo == "\n") { // newlines ignored inside block
             } else if (token->cargo == "break") {
-                nodes->push_back(new NodeBreak());
+                nodes->push_back(locate(new NodeBreak(), token));
             } else {
                 nodes->push_back(parseLineExpression(token));
             }
@@ -112,7 +124,8 @@ AbstractNode *Parser::parseVarDefinition(Token *identifier) {
     }
 
     AbstractNode *expression = parseExpression(input, token->lineIndex, token->colIndex);
-    NodeVariableDefinition *varDefinition = new NodeVariableDefinition(identifier->cargo, expression);
+    AbstractNode *varDefinition = locate(new NodeVariableDefinition(symbols->intern(identifier->cargo), expression), identifier);
+    varDefinition->location.node += " =";
 
     delete token;
     for (auto const &value: input) {
@@ -208,23 +221,19 @@ AbstractNode *Parser::parseExpression(vector<Token *> input, int lineIndex, int
     stack<Token *> operatorStack;
     for (auto const &value : input) {
         if (value->tokenType == TOKEN_INT) {
-            output->push(new NodeConstant(new TypeInt(stoi(value->cargo))));
+            output->push(locate(new NodeConstant(constants->addInt(stoi(value->cargo))), value));
         } else if (value->tokenType == TOKEN_CHAR) {
-            output->push(new NodeConstant(new TypeChar(value->cargo[0])));
+            output->push(locate(new NodeConstant(constants->addChar(value->cargo[0])), value));
         } else if (value->tokenType == TOKEN_STRING) {
-            vector<AbstractType *> *chars = new vector<AbstractType *>();
-            for (unsigned int i = 0; i < value->cargo.length(); i++) {
-                chars->push_back(new TypeChar(value->cargo[i]));
-            }
-            output->push(new NodeConstant(new TypeList(chars)));
+            output->push(locate(new NodeConstant(constants->addString(value->cargo)), value));
         } else if (value->tokenType == TOKEN_BOOL) {
-            output->push(new NodeConstant(new TypeBool(value->cargo == "True")));
+            output->push(locate(new NodeConstant(constants->addBool(value->cargo == "True")), value));
         } else if (value->tokenType == TOKEN_SCAN) {
-            output->push(parseScanToken(value));
+            output->push(locate(parseScanToken(value), value));
         } else if (value->tokenType == TOKEN_LIST) {
-            output->push(new NodeConstant(new TypeList(new vector<AbstractType *>())));
+            output->push(locate(new NodeConstant(constants->addString("")), value));
         } else if (value->tokenType == TOKEN_IDENTIFIER) {
-            output->push(new NodeVariableName(value->cargo));
+            output->push(locate(new NodeVariableName(symbols->intern(value->cargo)), value));
         } else if (value->tokenType == TOKEN_SYMBOL) {
             if (value->cargo == "(") {
                 operatorStack.push(value);
@@ -308,8 +317,7 @@ void Parser::createBinaryOperator(Operator op, stack<AbstractNode *> *output, To
     AbstractNode *operand1 = output->top();
     output->pop();
 
-    NodeBinaryOperator *binaryOperator = new NodeBinaryOperator(op, operand1, operand2);
-    output->push(binaryOperator);
+    output->push(locate(new NodeBinaryOperator(op, operand1, operand2), token));
 }
 
 void Parser::createNotOperator(stack<AbstractNode *> *output, Token *token) {
@@ -317,7 +325,7 @@ void Parser::createNotOperator(stack<AbstractNode *> *output, Token *token) {
         parseError("Not enough operands for ! operator.", token->lineIndex, token->colIndex);
         return;
     }
-    NodeNotOperator *notOperator = new NodeNotOperator(output->top());
+    AbstractNode *notOperator = locate(new NodeNotOperator(output->top()), token);
     output->pop();
     output->push(notOperator);
 }
@@ -327,7 +335,7 @@ void Parser::createLenFunction(std::stack<AbstractNode *> *output, Token *token)
         parseError("Missing argument for len function.", token->lineIndex, token->colIndex);
         return;
     }
-    NodeLen *len = new NodeLen(output->top());
+    AbstractNode *len = locate(new NodeLen(output->top()), token);
     output->pop();
     output->push(len);
 }
@@ -344,8 +352,7 @@ void Parser::createAppendFunction(std::stack<AbstractNode *> *output, Token * to
     AbstractNode *listExpression = output->top();
     output->pop();
 
-    NodeAppend *append = new NodeAppend(listExpression, elementExpression);
-    output->push(append);
+    output->push(locate(new NodeAppend(listExpression, elementExpression), token));
 }
 
 void Parser::createGetFunction(std::stack<AbstractNode *> *output, Token *token) {
@@ -360,8 +367,7 @@ void Parser::createGetFunction(std::stack<AbstractNode *> *output, Token *token)
     AbstractNode *listExpression = output->top();
     output->pop();
 
-    NodeGet *get = new NodeGet(listExpression, indexExpression);
-    output->push(get);
+    output->push(locate(new NodeGet(listExpression, indexExpression), token));
 }
 
 void Parser::createSetFunction(std::stack<AbstractNode *> *output, Token *token) {
@@ -379,8 +385,7 @@ void Parser::createSetFunction(std::stack<AbstractNode *> *output, Token *token)
     AbstractNode *listExpression = output->top();
     output->pop();
 
-    NodeSet *get = new NodeSet(listExpression, indexExpression, valueExpression);
-    output->push(get);
+    output->push(locate(new NodeSet(listExpression, indexExpression, valueExpression), token));
 }
 
 int Parser::operatorPriority(Token *op) {
@@ -4,17 +4,28 @@
 #include <vector>
 #include <stack>
 
+#include "constant_pool.h"
 #include "lexer.h"
 #include "node.h"
+#include "symbol_table.h"
 #include "utils.h"
 
 class Parser {
 public:
+    Parser() : symbols(new SymbolTable()), constants(new ConstantPool()) { };
+
+    ~Parser();
+
     AbstractNode *parse(std::string source);
 
+    SymbolTable *symbols;
+    ConstantPool *constants;
+
 private:
     Lexer *lexer;
 
+    AbstractNode *locate(AbstractNode *node, Token *token);
+
     void assertToken(Token *token, std::string expectedType, std::string expectedCargo);
 
     void assertNextToken(std::string expectedType, std::string expectedCargo);
@@ -0,0 +1,147 @@
+#include <cstdlib>
+#include <new>
+
+#include "slab.h"
+
+using namespace std;
+
+Slab *Slab::create(size_t cellSize) {
+    void *memory;
+    if (posix_memalign(&memory, Size, Size) != 0) {
+        throw bad_alloc();
+    }
+
+    Slab *slab = new(memory) Slab();
+    size_t header = (sizeof(Slab) + cellSize - 1) / cellSize * cellSize;
+    slab->cellSize = cellSize;
+    slab->cellCount = (unsigned) min((Size - header) / cellSize, (size_t) MaxCells);
+    slab->liveCount = 0;
+    slab->cells = (char *) memory + header;
+    for (unsigned i = 0; i < MaxCells / 64; i++) {
+        slab->allocated[i] = 0;
+        slab->marks[i].store(0);
+    }
+    return slab;
+}
+
+void Slab::destroy() {
+    for (unsigned i = 0; i < cellCount; i++) {
+        if (isAllocated(i)) {
+            ((AbstractType *) cell(i))->~AbstractType();
+        }
+    }
+    free(this);
+}
+
+void Slab::setAllocated(unsigned index, bool value) {
+    if (value) {
+        allocated[index / 64] |= (uint64_t) 1 << (index % 64);
+    } else {
+        allocated[index / 64] &= ~((uint64_t) 1 << (index % 64));
+    }
+}
+
+// Returns true if the cell was not marked yet. Safe to call from several marking threads.
+bool Slab::mark(unsigned index) {
+    uint64_t bit = (uint64_t) 1 << (index % 64);
+    if (marks[index / 64].load(memory_order_relaxed) & bit) {
+        return false;
+    }
+    return (marks[index / 64].fetch_or(bit) & bit) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+SlabAllocator::~SlabAllocator() {
+    for (auto const &slab : slabs) {
+        slab->destroy();
+    }
+    for (auto const &slab : unswept) {
+        slab->destroy();
+    }
+}
+
+void *SlabAllocator::allocate() {
+    while (freeList == nullptr && !unswept.empty()) {
+        Slab *slab = unswept.back();
+        unswept.pop_back();
+        sweep(slab);
+    }
+    if (freeList == nullptr) {
+        addSlab();
+    }
+
+    FreeCell *cell = freeList;
+    freeList = cell->next;
+
+    Slab *slab = Slab::of(cell);
+    slab->setAllocated(slab->indexOf(cell), true);
+    slab->liveCount++;
+    liveCount++;
+    return cell;
+}
+
+// Called when marking is complete, every slab has to be swept before it can be allocated from again.
+void SlabAllocator::startSweep() {
+    unswept.insert(unswept.end(), slabs.begin(), slabs.end());
+    slabs.clear();
+    freeList = nullptr;
+}
+
+// Sweeps slabs until the deadline. Returns true when all slabs are swept.
+bool SlabAllocator::sweep(chrono::steady_clock::time_point deadline) {
+    while (!unswept.empty()) {
+        Slab *slab = unswept.back();
+        unswept.pop_back();
+        sweep(slab);
+
+        if (chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    return unswept.empty();
+}
+
+// Unmarked cells are freed and the survivors are unmarked again, ready for the next marking.
+void SlabAllocator::sweep(Slab *slab) {
+    for (unsigned word = 0; word < Slab::MaxCells / 64; word++) {
+        uint64_t marks = slab->marks[word].exchange(0);
+        uint64_t dead = slab->allocated[word] & ~marks;
+
+        while (dead != 0) {
+            unsigned i = word * 64 + (unsigned) __builtin_ctzll(dead);
+            ((AbstractType *) slab->cell(i))->~AbstractType();
+            slab->liveCount--;
+            liveCount--;
+            dead &= dead - 1;
+        }
+        slab->allocated[word] &= marks;
+    }
+
+    if (slab->liveCount == 0) {
+        slab->destroy();
+        return;
+    }
+
+    for (unsigned i = slab->cellCount; i-- > 0;) {
+        if (!slab->isAllocated(i)) {
+            release(slab->cell(i));
+        }
+    }
+    slabs.push_back(slab);
+}
+
+void SlabAllocator::addSlab() {
+    Slab *slab = Slab::create(cellSize);
+    slabs.push_back(slab);
+
+    for (unsigned i = slab->cellCount; i-- > 0;) {
+        release(slab->cell(i));
+    }
+}
+
+void SlabAllocator::release(void *cell) {
+    FreeCell *freeCell = (FreeCell *) cell;
+    freeCell->next = freeList;
+    freeList = freeCell;
+}
@@ -0,0 +1,85 @@
+#ifndef TEETON_SLAB_H
+#define TEETON_SLAB_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "type.h"
+
+// Block of equally sized cells. Slabs are aligned to their size, so the slab of any cell
+// can be found by masking the cell address. Allocation and mark bits are kept in bitmaps in the
+// slab header, so marking does not write into the objects and sweeping works on whole words.
+class Slab {
+public:
+    static const size_t Size = 64 * 1024;
+    static const unsigned MaxCells = 4096;
+
+    static Slab *create(size_t cellSize);
+
+    static Slab *of(void *cell) { return (Slab *) ((uintptr_t) cell & ~((uintptr_t) Size - 1)); };
+
+    void destroy();
+
+    char *cell(unsigned index) { return cells + index * cellSize; };
+
+    unsigned indexOf(void *cell) { return (unsigned) (((char *) cell - cells) / cellSize); };
+
+    bool isAllocated(unsigned index) { return (allocated[index / 64] >> (index % 64)) & 1; };
+
+    void setAllocated(unsigned index, bool value);
+
+    bool mark(unsigned index);
+
+    size_t cellSize;
+    unsigned cellCount;
+    unsigned liveCount;
+    char *cells;
+    uint64_t allocated[MaxCells / 64];
+    std::atomic<uint64_t> marks[MaxCells / 64];
+};
+
+// -----------------------------------------------------------------------------
+
+// Pool of heap objects of one size class with a free list threaded through the free cells.
+// Slabs are swept lazily after marking - the free list only ever holds cells of swept slabs, the rest
+// is swept in steps or on demand when the free list runs out.
+class SlabAllocator {
+public:
+    SlabAllocator(size_t cellSize) : cellSize((cellSize + 15) & ~((size_t) 15)) { };
+
+    ~SlabAllocator();
+
+    void *allocate();
+
+    unsigned size() { return liveCount; };
+
+    size_t bytes() { return liveCount * cellSize; };
+
+    void startSweep();
+
+    bool sweep(std::chrono::steady_clock::time_point deadline);
+
+    bool isSweeping() { return !unswept.empty(); };
+
+private:
+    struct FreeCell {
+        FreeCell *next;
+    };
+
+    void addSlab();
+
+    void release(void *cell);
+
+    void sweep(Slab *slab);
+
+    size_t cellSize;
+    std::vector<Slab *> slabs;
+    std::vector<Slab *> unswept;
+    FreeCell *freeList = nullptr;
+    unsigned liveCount = 0;
+};
+
+#endif //TEETON_SLAB_H
@@ -0,0 +1,15 @@
+#include "symbol_table.h"
+
+using namespace std;
+
+unsigned SymbolTable::intern(const string &name) {
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        return it->second;
+    }
+
+    unsigned slot = (unsigned) names.size();
+    slots[name] = slot;
+    names.push_back(name);
+    return slot;
+}
@@ -0,0 +1,24 @@
+#ifndef TEETON_SYMBOL_TABLE_H
+#define TEETON_SYMBOL_TABLE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Names of variables interned by the parser. Every name gets a slot, variables of the environment
+// are stored in a flat array indexed by the slot. The table lives as long as the parser, so names
+// keep their slots across REPL inputs.
+class SymbolTable {
+public:
+    unsigned intern(const std::string &name);
+
+    const std::string &name(unsigned slot) { return names[slot]; };
+
+    unsigned size() { return (unsigned) names.size(); };
+
+private:
+    std::unordered_map<std::string, unsigned> slots;
+    std::vector<std::string> names;
+};
+
+#endif //TEETON_SYMBOL_TABLE_H
@@ -1,188 +1,405 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "type.h"
 #include "environment.h"
 
 using namespace std;
 
-inline AbstractType::~AbstractType() { }
+bool Value::supportsOperator(Operator op) const {
+    if (op == EQEQ) {
+        return true;
+    }
 
-bool AbstractType::supportsOperator(Operator op) {
-    switch (op) {
-        case EQEQ:
-            return true;
-        default:
-            return false;
+    switch (type()) {
+        case BOOL:
+            return op == EQ || op == NEQ || op == AND || op == OR;
+        case CHAR:
+            return op == EQ || op == NEQ || op == GT || op == LT || op == GTE || op == LTE;
+        case INT:
+            return op != AND && op != OR;
+        case LIST:
+            return listValue()->supportsOperator(op);
     }
+    return false;
 }
 
-AbstractType *AbstractType::applyOperator(Operator op, AbstractType *other, Environment *env) {
-    switch (op) {
-        case EQEQ:
-            return env->allocBool(this == other);
-        default:
-            runtimeError("Operator not suported for type");
-            return NULL;
+Value Value::applyOperator(Operator op, Value other, Environment *env) const {
+    if (op == EQEQ) {
+        return env->makeBool(bits == other.bits);
+    }
+
+    switch (type()) {
+        case BOOL: {
+            bool a = boolValue();
+            bool b = other.boolValue();
+            switch (op) {
+                case EQ:
+                    return env->makeBool(a == b);
+                case NEQ:
+                    return env->makeBool(a != b);
+                case AND:
+                    return env->makeBool(a && b);
+                case OR:
+                    return env->makeBool(a || b);
+                default:
+                    break;
+            }
+            break;
+        }
+        case CHAR: {
+            char a = charValue();
+            char b = other.charValue();
+            switch (op) {
+                case EQ:
+                    return env->makeBool(a == b);
+                case NEQ:
+                    return env->makeBool(a != b);
+                case GT:
+                    return env->makeBool(a > b);
+                case LT:
+                    return env->makeBool(a < b);
+                case GTE:
+                    return env->makeBool(a >= b);
+                case LTE:
+                    return env->makeBool(a <= b);
+                default:
+                    break;
+            }
+            break;
+        }
+        case INT: {
+            int a = intValue();
+            int b = other.intValue();
+            switch (op) {
+                case ADD:
+                    return env->makeInt(a + b);
+                case SUB:
+                    return env->makeInt(a - b);
+                case MUL:
+                    return env->makeInt(a * b);
+                case DIV:
+                    return env->makeInt(a / b);
+                case MOD:
+                    return env->makeInt(a % b);
+                case EQ:
+                    return env->makeBool(a == b);
+                case NEQ:
+                    return env->makeBool(a != b);
+                case GT:
+                    return env->makeBool(a > b);
+                case LT:
+                    return env->makeBool(a < b);
+                case GTE:
+                    return env->makeBool(a >= b);
+                case LTE:
+                    return env->makeBool(a <= b);
+                default:
+                    break;
+            }
+            break;
+        }
+        case LIST:
+            return listValue()->applyOperator(op, other.listValue(), env);
+    }
+
+    return env->fail("Operator not suported for type");
+}
+
+string Value::toString() const {
+    switch (type()) {
+        case BOOL:
+            return boolValue() ? "True" : "False";
+        case CHAR:
+            return string(1, charValue());
+        case INT:
+            return to_string(intValue());
+        case LIST:
+            return listValue()->toString();
     }
+    return "";
 }
 
 // -----------------------------------------------------------------------------
 
-Type TypeBool::type() {
-    return BOOL;
+inline AbstractType::~AbstractType() { }
+
+// -----------------------------------------------------------------------------
+
+size_t ListStorage::allocatedBytes = 0;
+size_t ListStorage::grownBytes[LIST_KIND_COUNT] = {};
+
+ListStorage::~ListStorage() {
+    allocatedBytes -= accountedBytes;
+    free(data);
+    free(identities);
 }
 
-bool TypeBool::value() {
-    return _value;
+ListStorage *ListStorage::copy(unsigned length) {
+    ListStorage *storage = new ListStorage(kind);
+    storage->appendAll(this, length);
+    return storage;
 }
 
-bool TypeBool::supportsOperator(Operator op) {
-    switch (op) {
-        case EQ:
-        case NEQ:
-        case AND:
-        case OR:
-            return true;
-        default:
-            return AbstractType::supportsOperator(op);
-    }
+void ListStorage::truncate(unsigned length) {
+    count = min(count, length);
 }
 
-AbstractType *TypeBool::applyOperator(Operator op, AbstractType *other, Environment *env) {
-    TypeBool *otherBool = (TypeBool *) other;
-    switch (op) {
-        case EQ:
-            return env->allocBool(_value == otherBool->value());
-        case NEQ:
-            return env->allocBool(_value != otherBool->value());
-        case AND:
-            return env->allocBool(_value && otherBool->value());
-        case OR:
-            return env->allocBool(_value || otherBool->value());
+Value ListStorage::get(unsigned index) {
+    switch (kind) {
+        case STRING_LIST:
+            return Value::fromChar(data[index], identities[index]);
+        case INT_LIST:
+            return Value::fromInt(ints()[index], identities[index]);
         default:
-            return AbstractType::applyOperator(op, other, env);
+            return items()[index];
     }
 }
 
-string TypeBool::toString() {
-    return _value ? "True" : "False";
+void ListStorage::set(unsigned index, Value value) {
+    if (kind == STRING_LIST && value.type() == CHAR) {
+        data[index] = value.charValue();
+        identities[index] = value.identity();
+    } else if (kind == INT_LIST && value.type() == INT) {
+        ints()[index] = value.intValue();
+        identities[index] = value.identity();
+    } else {
+        generalize();
+        items()[index] = value;
+    }
 }
 
-// -----------------------------------------------------------------------------
+void ListStorage::append(Value value) {
+    if (count == 0) {
+        convert(kindOf(value));
+    }
 
-Type TypeChar::type() {
-    return CHAR;
+    if (!(kind == STRING_LIST && value.type() == CHAR) && !(kind == INT_LIST && value.type() == INT)) {
+        generalize();
+    }
+
+    reserve(count + 1);
+    switch (kind) {
+        case STRING_LIST:
+            data[count] = value.charValue();
+            identities[count] = value.identity();
+            break;
+        case INT_LIST:
+            ints()[count] = value.intValue();
+            identities[count] = value.identity();
+            break;
+        default:
+            items()[count] = value;
+    }
+    count++;
 }
 
-char TypeChar::value() {
-    return _value;
+void ListStorage::appendAll(ListStorage *other, unsigned length) {
+    if (count == 0) {
+        convert(other->kind);
+    }
+
+    if (kind == other->kind && kind != GENERIC_LIST) {
+        size_t size = elementSize(kind);
+        reserve(count + length);
+        if (length > 0) {
+            memcpy(data + count * size, other->data, length * size);
+            memcpy(identities + count, other->identities, length * sizeof(unsigned));
+        }
+        count += length;
+        return;
+    }
+
+    generalize();
+    reserve(count + length);
+    for (unsigned i = 0; i < length; i++) {
+        items()[count++] = other->get(i);
+    }
 }
 
-bool TypeChar::supportsOperator(Operator op) {
-    switch (op) {
-        case EQ:
-        case NEQ:
-        case GT:
-        case LT:
-        case GTE:
-        case LTE:
-            return true;
+size_t ListStorage::elementSize(ListKind kind) {
+    switch (kind) {
+        case STRING_LIST:
+            return 1;
+        case INT_LIST:
+            return sizeof(int);
         default:
-            return AbstractType::supportsOperator(op);
+            return sizeof(Value);
     }
 }
 
-AbstractType *TypeChar::applyOperator(Operator op, AbstractType *other, Environment *env) {
-    TypeChar *otherChar = (TypeChar *) other;
-    switch (op) {
-        case EQ:
-            return env->allocBool(_value == otherChar->value());
-        case NEQ:
-            return env->allocBool(_value != otherChar->value());
-        case GT:
-            return env->allocBool(_value > otherChar->value());
-        case LT:
-            return env->allocBool(_value < otherChar->value());
-        case GTE:
-            return env->allocBool(_value >= otherChar->value());
-        case LTE:
-            return env->allocBool(_value <= otherChar->value());
+// An empty storage takes the kind of its first element.
+void ListStorage::convert(ListKind newKind) {
+    if (newKind == kind) {
+        return;
+    }
+
+    free(data);
+    free(identities);
+    data = nullptr;
+    identities = nullptr;
+    capacity = 0;
+    kind = newKind;
+    account();
+}
+
+ListKind ListStorage::kindOf(Value value) {
+    switch (value.type()) {
+        case CHAR:
+            return STRING_LIST;
+        case INT:
+            return INT_LIST;
         default:
-            return AbstractType::applyOperator(op, other, env);
+            return GENERIC_LIST;
+    }
+}
+
+// The buffer grows by doubling like a vector and a failed allocation throws like one.
+void ListStorage::reserve(unsigned elements) {
+    if (elements <= capacity) {
+        return;
+    }
+
+    unsigned grown = max(elements, capacity * 2);
+    char *grownData = (char *) realloc(data, grown * elementSize(kind));
+    if (grownData == nullptr) {
+        throw bad_alloc();
     }
+    data = grownData;
+    if (kind != GENERIC_LIST) {
+        unsigned *grownIdentities = (unsigned *) realloc(identities, grown * sizeof(unsigned));
+        if (grownIdentities == nullptr) {
+            throw bad_alloc();
+        }
+        identities = grownIdentities;
+    }
+    capacity = grown;
+    account();
 }
 
-string TypeChar::toString() {
-    string s;
-    s.push_back(_value);
-    return s;
+void ListStorage::account() {
+    size_t bytes = sizeof(ListStorage) + capacity * elementSize(kind);
+    if (kind != GENERIC_LIST) {
+        bytes += capacity * sizeof(unsigned);
+    }
+    allocatedBytes += bytes - accountedBytes;
+    if (bytes > accountedBytes) {
+        grownBytes[kind] += bytes - accountedBytes;
+    }
+    accountedBytes = bytes;
 }
 
-// -----------------------------------------------------------------------------
+void ListStorage::generalize() {
+    if (kind == GENERIC_LIST) {
+        return;
+    }
 
-Type TypeInt::type() {
-    return INT;
+    unsigned grown = max(count, 1u);
+    Value *generic = (Value *) malloc(grown * sizeof(Value));
+    if (generic == nullptr) {
+        throw bad_alloc();
+    }
+    for (unsigned i = 0; i < count; i++) {
+        generic[i] = get(i);
+    }
+    free(data);
+    free(identities);
+    identities = nullptr;
+    kind = GENERIC_LIST;
+    data = (char *) generic;
+    capacity = grown;
+    account();
 }
 
-int TypeInt::value() {
-    return _value;
+// -----------------------------------------------------------------------------
+
+static unsigned firstMismatch(const char *a, const char *b, unsigned length) {
+    unsigned i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (mask != 0xffff) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while (i < length && a[i] == b[i]) {
+        i++;
+    }
+    return i;
 }
 
-bool TypeInt::supportsOperator(Operator op) {
-    switch (op) {
-        case ADD:
-        case SUB:
-        case MUL:
-        case DIV:
-        case MOD:
-        case EQ:
-        case NEQ:
-        case GT:
-        case LT:
-        case GTE:
-        case LTE:
-            return true;
-        default:
-            return AbstractType::supportsOperator(op);
+static unsigned firstMismatch(const int *a, const int *b, unsigned length) {
+    unsigned i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= length; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        unsigned mask = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)));
+        if (mask != 0xf) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while (i < length && a[i] == b[i]) {
+        i++;
     }
+    return i;
 }
 
-AbstractType *TypeInt::applyOperator(Operator op, AbstractType *other, Environment *env) {
-    TypeInt *otherInt = (TypeInt *) other;
-    switch (op) {
-        case ADD:
-            return env->allocInt(_value + otherInt->value());
-        case SUB:
-            return env->allocInt(_value - otherInt->value());
-        case MUL:
-            return env->allocInt(_value * otherInt->value());
-        case DIV:
-            return env->allocInt(_value / otherInt->value());
-        case MOD:
-            return env->allocInt(_value % otherInt->value());
-        case EQ:
-            return env->allocBool(_value == otherInt->value());
-        case NEQ:
-            return env->allocBool(_value != otherInt->value());
-        case GT:
-            return env->allocBool(_value > otherInt->value());
-        case LT:
-            return env->allocBool(_value < otherInt->value());
-        case GTE:
-            return env->allocBool(_value >= otherInt->value());
-        case LTE:
-            return env->allocBool(_value <= otherInt->value());
-        default:
-            return AbstractType::applyOperator(op, other, env);
+static bool equalValues(Value a, Value b) {
+    if (a.type() != b.type()) {
+        return false;
+    }
+
+    switch (a.type()) {
+        case BOOL:
+            return a.boolValue() == b.boolValue();
+        case CHAR:
+            return a.charValue() == b.charValue();
+        case INT:
+            return a.intValue() == b.intValue();
+        case LIST:
+            return a.listValue()->equals(b.listValue());
     }
+    return false;
 }
 
-string TypeInt::toString() {
-    return to_string(_value);
+// Values which cannot be compared fail the comparison, it returns 0 then.
+static int compareValues(Value a, Value b, Environment *env) {
+    if (a.type() != b.type()) {
+        env->fail("Cannot apply operator for different types.");
+        return 0;
+    }
+
+    switch (a.type()) {
+        case CHAR:
+            return a.charValue() < b.charValue() ? -1 : (a.charValue() > b.charValue() ? 1 : 0);
+        case INT:
+            return a.intValue() < b.intValue() ? -1 : (a.intValue() > b.intValue() ? 1 : 0);
+        case LIST:
+            return a.listValue()->compare(b.listValue(), env);
+        default:
+            env->fail("Operator not suported for type");
+            return 0;
+    }
 }
 
 // -----------------------------------------------------------------------------
 
 TypeList::~TypeList() {
-    delete _value;
+    if (--storage->references == 0) {
+        delete storage;
+    }
 }
 
 Type TypeList::type() {
@@ -198,84 +415,191 @@ bool TypeList::supportsOperator(Operator op) {
         case LT:
         case GTE:
         case LTE:
+        case EQEQ:
             return true;
         default:
-            return AbstractType::supportsOperator(op);
+            return false;
     }
 }
 
-AbstractType *TypeList::applyOperator(Operator op, AbstractType *other, Environment *env) {
-    TypeList *otherList = (TypeList *) other;
+Value TypeList::applyOperator(Operator op, TypeList *otherList, Environment *env) {
     switch (op) {
         case ADD: {
-            vector<AbstractType *> * new_vector = new vector<AbstractType *>(*_value);
-            new_vector->insert(new_vector->end(), otherList->value()->begin(), otherList->value()->end());
-            return env->allocList(new_vector);
-        }
-        case EQ: {
-            if (_value->size() != otherList->value()->size()) {
-                return env->allocBool(false);
+            if (isTip() && storage != otherList->storage) {
+                storage->appendAll(otherList->storage, otherList->length);
+                return Value::fromList(env->allocList(share(), length + otherList->length));
             }
-            for (unsigned i = 0; i < _value->size(); i++) {
-                TypeBool *result = (TypeBool *) _value->at(i)->applyOperator(NEQ, otherList->value()->at(i), env);
-                if (result->value()) {
-                    return env->allocBool(false);
-                }
-            }
-            return env->allocBool(true);
+            ListStorage *newStorage = storage->copy(length);
+            newStorage->appendAll(otherList->storage, otherList->length);
+            return Value::fromList(env->allocList(newStorage, newStorage->size()));
         }
-        case NEQ: {
-            TypeBool *result = (TypeBool *) applyOperator(EQ, other, env);
-            return env->allocBool(!result->value());
+        case EQ:
+            return env->makeBool(equals(otherList));
+        case NEQ:
+            return env->makeBool(!equals(otherList));
+        case GT:
+            return env->makeBool(compare(otherList, env) > 0);
+        case LT:
+            return env->makeBool(compare(otherList, env) < 0);
+        case GTE:
+            return env->makeBool(compare(otherList, env) >= 0);
+        case LTE:
+            return env->makeBool(compare(otherList, env) <= 0);
+        default:
+            return env->fail("Operator not suported for type");
+    }
+}
+
+bool TypeList::equals(TypeList *other) {
+    if (length != other->length) {
+        return false;
+    }
+
+    if (kind() == STRING_LIST && other->kind() == STRING_LIST) {
+        return memcmp(storage->chars(), other->storage->chars(), length) == 0;
+    }
+
+    if (kind() == INT_LIST && other->kind() == INT_LIST) {
+        return memcmp(storage->ints(), other->storage->ints(), length * sizeof(int)) == 0;
+    }
+
+    for (unsigned i = 0; i < length; i++) {
+        if (!equalValues(storage->get(i), other->storage->get(i))) {
+            return false;
         }
-        case GT: {
-            for (unsigned i = 0; i < _value->size(); i++) {
-                if (i < otherList->value()->size()) {
-                    TypeBool *result = (TypeBool *) _value->at(i)->applyOperator(LTE, otherList->value()->at(i), env);
-                    if (result->value()) {
-                        return env->allocBool(false);
-                    }
-                } else {
-                    return env->allocBool(false);
-                }
+    }
+    return true;
+}
+
+int TypeList::compare(TypeList *other, Environment *env) {
+    unsigned common = min(length, other->length);
+    unsigned i;
+
+    if (kind() == STRING_LIST && other->kind() == STRING_LIST) {
+        i = firstMismatch(storage->chars(), other->storage->chars(), common);
+    } else if (kind() == INT_LIST && other->kind() == INT_LIST) {
+        i = firstMismatch(storage->ints(), other->storage->ints(), common);
+    } else {
+        for (i = 0; i < common; i++) {
+            int result = compareValues(storage->get(i), other->storage->get(i), env);
+            if (result != 0 || env->abrupt()) {
+                return result;
             }
-            return env->allocBool(true);
-        }
-        case LT: {
-            TypeBool *resultEQ = (TypeBool *) applyOperator(EQ, other, env);
-            TypeBool *resultGT = (TypeBool *) applyOperator(GT, other, env);
-            return env->allocBool(!resultEQ->value() && !resultGT->value());
-        }
-        case GTE: {
-            TypeBool *result = (TypeBool *) applyOperator(LT, other, env);
-            return env->allocBool(!result->value());
-        }
-        case LTE: {
-            TypeBool *result = (TypeBool *)applyOperator(GT, other, env);
-            return env->allocBool(!result->value());
         }
-        default:
-            return AbstractType::applyOperator(op, other, env);
     }
+
+    if (i < common) {
+        return compareValues(storage->get(i), other->storage->get(i), env);
+    }
+    return length < other->length ? -1 : (length > other->length ? 1 : 0);
+}
+
+ListKind TypeList::kind() {
+    return storage->kind;
+}
+
+unsigned TypeList::size() {
+    return length;
+}
+
+Value TypeList::get(unsigned index) {
+    if (index >= length) {
+        throw out_of_range("list index out of range");
+    }
+    return storage->get(index);
+}
+
+void TypeList::set(unsigned index, Value value) {
+    detach();
+    storage->set(index, value);
+}
+
+Value TypeList::intAt(unsigned index) {
+    if (index >= length) {
+        throw out_of_range("list index out of range");
+    }
+    return Value::fromInt(storage->ints()[index], storage->identities[index]);
+}
+
+Value TypeList::charAt(unsigned index) {
+    if (index >= length) {
+        throw out_of_range("list index out of range");
+    }
+    return Value::fromChar(storage->chars()[index], storage->identities[index]);
+}
+
+void TypeList::setInt(unsigned index, Value value) {
+    detach();
+    storage->ints()[index] = value.intValue();
+    storage->identities[index] = value.identity();
+}
+
+void TypeList::setChar(unsigned index, Value value) {
+    detach();
+    storage->chars()[index] = value.charValue();
+    storage->identities[index] = value.identity();
+}
+
+void TypeList::append(Value value) {
+    prepareAppend();
+    storage->append(value);
+    length++;
+}
+
+Value *TypeList::references() {
+    return storage->kind == GENERIC_LIST ? storage->items() : nullptr;
 }
 
-vector<AbstractType *> * TypeList::value() {
-    return _value;
+ListStorage *TypeList::share() {
+    storage->references++;
+    return storage;
+}
+
+bool TypeList::isTip() {
+    return length == storage->size();
+}
+
+// Storage shared by several lists is split evenly between them.
+size_t TypeList::storageBytes() {
+    return storage->bytes() / storage->references;
+}
+
+bool TypeList::isConstant() {
+    return constant;
+}
+
+void TypeList::detach() {
+    if (storage->references > 1) {
+        storage->references--;
+        storage = storage->copy(length);
+    } else if (!isTip()) {
+        storage->truncate(length);
+    }
+}
+
+void TypeList::prepareAppend() {
+    if (!isTip()) {
+        detach();
+    }
 }
 
 string TypeList::toString() {
+    if (kind() == STRING_LIST && size() > 0) {
+        return string(storage->chars(), length);
+    }
+
     stringstream ss;
-    if (_value->size() > 0 && _value->front()->type() == CHAR) {
-        for (unsigned i = 0; i < _value->size(); i++) {
-            ss << _value->at(i)->toString();
+    if (size() > 0 && get(0).type() == CHAR) {
+        for (unsigned i = 0; i < size(); i++) {
+            ss << get(i).toString();
         }
     } else {
         ss << "[";
-        for (unsigned i = 0; i < _value->size(); i++) {
+        for (unsigned i = 0; i < size(); i++) {
             if (i > 0) {
                 ss << ", ";
             }
-            ss << _value->at(i)->toString();
+            ss << get(i).toString();
         }
         ss << "]";
     }
@@ -1,6 +1,7 @@
 #ifndef TEETON_TYPE_H
 #define TEETON_TYPE_H
 
+#include <cstdint>
 #include <vector>
 #include <sstream>
 
@@ -10,103 +11,232 @@
 
 class Environment;
 
+class TypeList;
 
-class AbstractType {
+
+// -----------------------------------------------------------------------------
+
+// Tagged value word - ints, bools and chars are stored inline, lists point to the heap.
+// Scalar layout: bits 0-2 tag, bits 3-31 identity (for ===), bits 32-63 payload.
+// Identities with ConstantIdentity bit set are reserved for literals from the constant pool. Runtime identities
+// are never reused, the program fails when they run out.
+class Value {
 public:
-    virtual ~AbstractType() = 0;
+    Value() : bits(0) { };
 
-    virtual Type type() = 0;
+    static Value fromInt(int value, unsigned identity = 0) { return scalar(TagInt, (uint32_t) value, identity); };
 
-    virtual bool supportsOperator(Operator op);
+    static Value fromBool(bool value, unsigned identity = 0) { return scalar(TagBool, value ? 1 : 0, identity); };
 
-    virtual AbstractType *applyOperator(Operator op, AbstractType *other, Environment *env);
+    static Value fromChar(char value, unsigned identity = 0) {
+        return scalar(TagChar, (unsigned char) value, identity);
+    };
 
-    virtual std::string toString() = 0;
+    static Value fromList(TypeList *list) { return Value((uint64_t) (uintptr_t) list); };
 
-    bool marked = false;
-};
+    Type type() const {
+        switch (bits & TagMask) {
+            case TagInt:
+                return INT;
+            case TagBool:
+                return BOOL;
+            case TagChar:
+                return CHAR;
+            default:
+                return LIST;
+        }
+    };
 
-// -----------------------------------------------------------------------------
+    bool isNull() const { return bits == 0; };
 
-class TypeBool : public AbstractType {
-public:
-    TypeBool(bool value) : _value(value) { };
+    bool isList() const { return bits != 0 && (bits & TagMask) == TagPointer; };
 
-    virtual Type type();
+    int intValue() const { return (int32_t) (bits >> PayloadShift); };
 
-    virtual bool supportsOperator(Operator op);
+    bool boolValue() const { return (bits >> PayloadShift) != 0; };
 
-    virtual AbstractType *applyOperator(Operator op, AbstractType *other, Environment *env);
+    char charValue() const { return (char) (bits >> PayloadShift); };
 
-    bool value();
+    unsigned identity() const { return (unsigned) ((bits >> IdentityShift) & IdentityMask); };
 
-    virtual std::string toString();
+    TypeList *listValue() const { return (TypeList *) (uintptr_t) bits; };
+
+    bool supportsOperator(Operator op) const;
+
+    Value applyOperator(Operator op, Value other, Environment *env) const;
+
+    std::string toString() const;
+
+    static const unsigned RuntimeIdentityMask = 0x0fffffff;
+    static const unsigned ConstantIdentity = 0x10000000;
 
 private:
-    bool _value;
-};
+    Value(uint64_t bits) : bits(bits) { };
 
-// -----------------------------------------------------------------------------
+    static Value scalar(uint64_t tag, uint32_t payload, unsigned identity) {
+        return Value(((uint64_t) payload << PayloadShift) | ((identity & IdentityMask) << IdentityShift) | tag);
+    };
 
-class TypeChar : public AbstractType {
-public:
-    TypeChar(char value) : _value(value) { };
+    static const uint64_t TagMask = 0x7;
+    static const uint64_t TagPointer = 0;
+    static const uint64_t TagInt = 1;
+    static const uint64_t TagBool = 2;
+    static const uint64_t TagChar = 3;
+    static const unsigned IdentityShift = 3;
+    static const uint64_t IdentityMask = 0x1fffffff;
+    static const unsigned PayloadShift = 32;
 
-    virtual Type type();
+    uint64_t bits;
 
-    virtual bool supportsOperator(Operator op);
+    friend class JitCompiler;
 
-    virtual AbstractType *applyOperator(Operator op, AbstractType *other, Environment *env);
+    friend class CEmitter;
+};
 
-    char value();
+// -----------------------------------------------------------------------------
 
-    virtual std::string toString();
+// Position of an AST node in the source. Lists point to the location of the node that allocated them.
+struct SourceLocation {
+    int lineIndex = 0;
+    int colIndex = 0;
+    std::string node;
+};
 
-private:
-    char _value;
+// -----------------------------------------------------------------------------
+
+class AbstractType {
+public:
+    virtual ~AbstractType() = 0;
+
+    virtual Type type() = 0;
+
+    virtual std::string toString() = 0;
 };
 
 // -----------------------------------------------------------------------------
 
-class TypeInt : public AbstractType {
+// Backing buffer of a list. It is reference counted so that lists can share it and copy it on first write.
+// A list sees only the first `length` elements, so a list at the end of the buffer can be extended in place.
+// Lists of chars and lists of ints are packed into contiguous buffers until a value of another type is stored into them.
+// The storage holds one buffer whose elements are Values, chars or ints by its kind. Packed elements keep
+// the identities that === compares in a parallel buffer, so the chars and ints stay contiguous.
+class ListStorage {
 public:
-    TypeInt(int value) : _value(value) { };
+    ListStorage(ListKind kind = GENERIC_LIST) : kind(kind) { account(); };
 
-    virtual Type type();
+    ~ListStorage();
 
-    virtual bool supportsOperator(Operator op);
+    size_t bytes() { return accountedBytes; };
 
-    virtual AbstractType *applyOperator(Operator op, AbstractType *other, Environment *env);
+    ListStorage *copy(unsigned length);
 
-    int value();
+    void truncate(unsigned length);
 
-    virtual std::string toString();
+    unsigned size() { return count; };
+
+    Value get(unsigned index);
+
+    void set(unsigned index, Value value);
+
+    void append(Value value);
+
+    void appendAll(ListStorage *other, unsigned length);
+
+    // elements by the kind of the storage
+    Value *items() { return (Value *) data; };
+
+    char *chars() { return data; };
+
+    int *ints() { return (int *) data; };
+
+    // identities of packed elements
+    unsigned *identities = nullptr;
+
+    ListKind kind;
+    unsigned references = 1;
+
+    static size_t allocatedBytes;
+    static size_t grownBytes[LIST_KIND_COUNT];  // all bytes ever allocated, by kind of list
 
 private:
-    int _value;
-};
+    void account();
+
+    void reserve(unsigned elements);
+
+    static size_t elementSize(ListKind kind);
+
+    void convert(ListKind newKind);
 
+    static ListKind kindOf(Value value);
+
+    void generalize();
+
+    char *data = nullptr;
+    unsigned count = 0;
+    unsigned capacity = 0;  // in elements
+    size_t accountedBytes = 0;
+};
 
 // -----------------------------------------------------------------------------
 
 class TypeList : public AbstractType {
 public:
-    TypeList(std::vector<AbstractType *> *value) : _value(value) { };
+    TypeList(ListStorage *storage, unsigned length, bool constant = false) : storage(storage), length(length),
+                                                                             constant(constant) { };
 
     ~TypeList();
 
     virtual Type type();
 
-    virtual bool supportsOperator(Operator op);
+    bool supportsOperator(Operator op);
+
+    Value applyOperator(Operator op, TypeList *other, Environment *env);
 
-    virtual AbstractType *applyOperator(Operator op, AbstractType *other, Environment *env);
+    bool equals(TypeList *other);
 
-    std::vector<AbstractType *> *value();
+    int compare(TypeList *other, Environment *env);
+
+    ListKind kind();
+
+    unsigned size();
+
+    Value get(unsigned index);
+
+    void set(unsigned index, Value value);
+
+    // elements of packed lists, the caller checks the kind of the list and of the value, see NodeGet and NodeSet
+    Value intAt(unsigned index);
+
+    Value charAt(unsigned index);
+
+    void setInt(unsigned index, Value value);
+
+    void setChar(unsigned index, Value value);
+
+    void append(Value value);
+
+    Value *references();
+
+    ListStorage *share();
+
+    bool isTip();
+
+    bool isConstant();
+
+    size_t storageBytes();
 
     virtual std::string toString();
 
+    SourceLocation *site = nullptr;
+
 private:
-    std::vector<AbstractType *> *_value;
+    void detach();
+
+    void prepareAppend();
+
+    ListStorage *storage;
+    unsigned length;
+    bool constant;
 };
 
 #endif //TEETON_TYPE_H
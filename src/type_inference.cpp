@@ -0,0 +1,310 @@
+#include "environment.h"
+#include "node.h"
+#include "type_inference.h"
+
+using namespace std;
+
+const TypeSet TypeInference::Any;
+const TypeSet TypeInference::Null;
+const TypeSet TypeInference::Undefined;
+
+void TypeState::join(const TypeState &other) {
+    if (!other.reachable) {
+        return;
+    }
+    if (!reachable) {
+        *this = other;
+        return;
+    }
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+        slots[slot] |= other.slots[slot];
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+TypeInference::TypeInference(Environment *env, unsigned slots) {
+    state.slots.resize(slots, Undefined);
+    for (unsigned slot = 0; slot < slots; slot++) {
+        if (env->isDefined(slot)) {
+            state.slots[slot] = of(env->getVariable(slot));
+        }
+    }
+}
+
+AbstractNode *TypeInference::run(AbstractNode *root) {
+    TypeSet types;
+    return root->infer(this, &types);
+}
+
+// A read of an undefined variable fails, so the value is one of the defined types.
+TypeSet TypeInference::variable(unsigned slot) {
+    if (!state.reachable) {
+        return 0;
+    }
+    return state.slots[slot] & ~Undefined;
+}
+
+void TypeInference::define(unsigned slot, TypeSet types) {
+    state.slots[slot] = types;
+}
+
+// Operators which fail produce no value, so only the combinations of types that succeed count.
+TypeSet TypeInference::result(Operator op, TypeSet a, TypeSet b) {
+    TypeSet both = a & b;
+    switch (op) {
+        case ADD:
+            return both & (of(INT) | of(LIST));
+        case SUB:
+        case MUL:
+        case DIV:
+        case MOD:
+            return both & of(INT);
+        case EQEQ:
+            return (a | b) != 0 ? of(BOOL) : 0;
+        default:
+            return both != 0 ? of(BOOL) : 0;
+    }
+}
+
+// The factories return null for operators the type does not support, the generic node reports the error.
+static NodeBinaryOperator *makeInt(Operator op, AbstractNode *a, AbstractNode *b) {
+    switch (op) {
+        case ADD:
+            return new NodeIntOperator<ADD>(a, b);
+        case SUB:
+            return new NodeIntOperator<SUB>(a, b);
+        case MUL:
+            return new NodeIntOperator<MUL>(a, b);
+        case DIV:
+            return new NodeIntOperator<DIV>(a, b);
+        case MOD:
+            return new NodeIntOperator<MOD>(a, b);
+        case EQ:
+            return new NodeIntOperator<EQ>(a, b);
+        case NEQ:
+            return new NodeIntOperator<NEQ>(a, b);
+        case GT:
+            return new NodeIntOperator<GT>(a, b);
+        case LT:
+            return new NodeIntOperator<LT>(a, b);
+        case GTE:
+            return new NodeIntOperator<GTE>(a, b);
+        case LTE:
+            return new NodeIntOperator<LTE>(a, b);
+        default:
+            return nullptr;
+    }
+}
+
+static NodeBinaryOperator *makeChar(Operator op, AbstractNode *a, AbstractNode *b) {
+    switch (op) {
+        case EQ:
+            return new NodeCharOperator<EQ>(a, b);
+        case NEQ:
+            return new NodeCharOperator<NEQ>(a, b);
+        case GT:
+            return new NodeCharOperator<GT>(a, b);
+        case LT:
+            return new NodeCharOperator<LT>(a, b);
+        case GTE:
+            return new NodeCharOperator<GTE>(a, b);
+        case LTE:
+            return new NodeCharOperator<LTE>(a, b);
+        default:
+            return nullptr;
+    }
+}
+
+static NodeBinaryOperator *makeBool(Operator op, AbstractNode *a, AbstractNode *b) {
+    switch (op) {
+        case EQ:
+            return new NodeBoolOperator<EQ>(a, b);
+        case NEQ:
+            return new NodeBoolOperator<NEQ>(a, b);
+        case AND:
+            return new NodeBoolOperator<AND>(a, b);
+        case OR:
+            return new NodeBoolOperator<OR>(a, b);
+        default:
+            return nullptr;
+    }
+}
+
+// The operands are moved over to the specialized node and the generic one is deleted. Sites whose
+// operands may have another type keep the generic node.
+AbstractNode *TypeInference::specialize(NodeBinaryOperator *node, TypeSet a, TypeSet b) {
+    if (!rewriting || node->op == EQEQ) {
+        return node;
+    }
+    sites++;
+
+    NodeBinaryOperator *replacement = nullptr;
+    if (a == b && a == of(INT)) {
+        replacement = makeInt(node->op, node->a, node->b);
+    } else if (a == b && a == of(CHAR)) {
+        replacement = makeChar(node->op, node->a, node->b);
+    } else if (a == b && a == of(BOOL)) {
+        replacement = makeBool(node->op, node->a, node->b);
+    }
+    if (replacement == nullptr) {
+        return node;
+    }
+
+    replacement->location = node->location;
+    node->a = nullptr;
+    node->b = nullptr;
+    delete node;
+    specialized++;
+    return replacement;
+}
+
+// -- Nodes --------------------------------------------------------------------
+
+AbstractNode *NodeBlock::infer(TypeInference *inference, TypeSet *types) {
+    *types = TypeInference::Null;
+    for (auto &node : *nodes) {
+        node = node->infer(inference, types);
+    }
+    return this;
+}
+
+AbstractNode *NodeVariableDefinition::infer(TypeInference *inference, TypeSet *types) {
+    TypeSet evaluated;
+    value = value->infer(inference, &evaluated);
+    inference->define(slot, evaluated);
+    *types = TypeInference::Null;
+    return this;
+}
+
+AbstractNode *NodeVariableName::infer(TypeInference *inference, TypeSet *types) {
+    *types = inference->variable(slot);
+    return this;
+}
+
+AbstractNode *NodePrint::infer(TypeInference *inference, TypeSet *types) {
+    value = value->infer(inference, types);
+    *types = TypeInference::Null;
+    return this;
+}
+
+AbstractNode *NodeBinaryOperator::infer(TypeInference *inference, TypeSet *types) {
+    TypeSet t1, t2;
+    a = a->infer(inference, &t1);
+    b = b->infer(inference, &t2);
+    *types = TypeInference::result(op, t1, t2);
+    return inference->specialize(this, t1, t2);
+}
+
+AbstractNode *NodeNotOperator::infer(TypeInference *inference, TypeSet *types) {
+    a = a->infer(inference, types);
+    *types = TypeInference::of(BOOL);
+    return this;
+}
+
+AbstractNode *NodeConstant::infer(TypeInference *inference, TypeSet *types) {
+    *types = TypeInference::of(value);
+    return this;
+}
+
+// The state at the head of the loop joins the state before it with the states at the end of the body
+// until it stops changing. The loop ends when the condition is false or at a break.
+AbstractNode *NodeWhile::infer(TypeInference *inference, TypeSet *types) {
+    vector<TypeState> *outerBreaks = inference->breaks;
+    vector<TypeState> breaks;
+    inference->breaks = &breaks;
+    bool rewriting = inference->rewriting;
+    inference->rewriting = false;
+
+    TypeState head = inference->state;
+    for (; ;) {
+        condition->infer(inference, types);
+        block->infer(inference, types);
+        inference->state.join(head);
+        if (inference->state == head) {
+            break;
+        }
+        head = inference->state;
+    }
+
+    inference->rewriting = rewriting;
+    inference->state = head;
+    breaks.clear();
+    condition = condition->infer(inference, types);
+    TypeState exit = inference->state;
+    block->infer(inference, types);
+    for (auto const &state : breaks) {
+        exit.join(state);
+    }
+
+    inference->state = exit;
+    inference->breaks = outerBreaks;
+    *types = TypeInference::Null;
+    return this;
+}
+
+AbstractNode *NodeIfElse::infer(TypeInference *inference, TypeSet *types) {
+    condition = condition->infer(inference, types);
+    TypeState before = inference->state;
+    ifBlock->infer(inference, types);
+    TypeState afterIf = inference->state;
+    inference->state = before;
+    elseBlock->infer(inference, types);
+    inference->state.join(afterIf);
+    *types = TypeInference::Null;
+    return this;
+}
+
+AbstractNode *NodeScanInt::infer(TypeInference *inference, TypeSet *types) {
+    *types = TypeInference::of(INT);
+    return this;
+}
+
+AbstractNode *NodeScanChar::infer(TypeInference *inference, TypeSet *types) {
+    *types = TypeInference::of(CHAR);
+    return this;
+}
+
+AbstractNode *NodeScanString::infer(TypeInference *inference, TypeSet *types) {
+    *types = TypeInference::of(LIST);
+    return this;
+}
+
+// A break outside of any loop ends the program, the code after a break is unreachable either way.
+AbstractNode *NodeBreak::infer(TypeInference *inference, TypeSet *types) {
+    if (inference->breaks != nullptr) {
+        inference->breaks->push_back(inference->state);
+    }
+    inference->state.reachable = false;
+    *types = TypeInference::Null;
+    return this;
+}
+
+AbstractNode *NodeLen::infer(TypeInference *inference, TypeSet *types) {
+    expression = expression->infer(inference, types);
+    *types = TypeInference::of(INT);
+    return this;
+}
+
+AbstractNode *NodeAppend::infer(TypeInference *inference, TypeSet *types) {
+    listExpression = listExpression->infer(inference, types);
+    valueExpression = valueExpression->infer(inference, types);
+    *types = TypeInference::Null;
+    return this;
+}
+
+// Types of the elements of lists are not tracked.
+AbstractNode *NodeGet::infer(TypeInference *inference, TypeSet *types) {
+    listExpression = listExpression->infer(inference, types);
+    indexExpression = indexExpression->infer(inference, types);
+    *types = TypeInference::Any;
+    return this;
+}
+
+AbstractNode *NodeSet::infer(TypeInference *inference, TypeSet *types) {
+    listExpression = listExpression->infer(inference, types);
+    indexExpression = indexExpression->infer(inference, types);
+    valueExpression = valueExpression->infer(inference, types);
+    *types = TypeInference::Null;
+    return this;
+}
@@ -0,0 +1,66 @@
+#ifndef TEETON_TYPE_INFERENCE_H
+#define TEETON_TYPE_INFERENCE_H
+
+#include <vector>
+
+#include "enums.h"
+#include "type.h"
+
+class AbstractNode;
+
+class Environment;
+
+class NodeBinaryOperator;
+
+// Types a node can evaluate to or a variable can hold, one bit for every Type.
+typedef unsigned TypeSet;
+
+// Types of all variables at one point of the program. An unreachable state follows a break, it is
+// left out of joins.
+struct TypeState {
+    std::vector<TypeSet> slots;
+    bool reachable = true;
+
+    void join(const TypeState &other);
+
+    bool operator==(const TypeState &other) const { return reachable == other.reachable && slots == other.slots; };
+};
+
+// Flow-sensitive inference of the types of variables, every node infers the types of its value from
+// the state before it and updates the state. Binary operators whose operands are known to be ints, chars
+// or bools are replaced with nodes which skip the checks of the types. Loops are inferred until the state
+// at their head stops changing and the operators in them are specialized only on the last pass.
+class TypeInference {
+public:
+    // types of variables already defined are taken from the environment
+    TypeInference(Environment *env, unsigned slots);
+
+    // returns the root to evaluate instead
+    AbstractNode *run(AbstractNode *root);
+
+    TypeSet variable(unsigned slot);
+
+    void define(unsigned slot, TypeSet types);
+
+    // returns the node itself or its specialized replacement
+    AbstractNode *specialize(NodeBinaryOperator *node, TypeSet a, TypeSet b);
+
+    static TypeSet result(Operator op, TypeSet a, TypeSet b);
+
+    static TypeSet of(Type type) { return 1u << type; };
+
+    static TypeSet of(Value value) { return value.isNull() ? Null : of(value.type()); };
+
+    static const TypeSet Any = (1u << CHAR) | (1u << BOOL) | (1u << INT) | (1u << LIST);
+    static const TypeSet Null = 1u << 4;  // statements, append and set
+    static const TypeSet Undefined = 1u << 5;  // the variable may not be defined yet
+
+    TypeState state;
+    std::vector<TypeState> *breaks = nullptr;  // states at the breaks of the innermost loop
+    bool rewriting = true;  // false while a loop is inferred before its last pass
+
+    unsigned sites = 0;  // binary operators except ===
+    unsigned specialized = 0;
+};
+
+#endif //TEETON_TYPE_INFERENCE_H
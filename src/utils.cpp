@@ -5,12 +5,6 @@
 
 using namespace std;
 
-void runtimeError(string err) {
-    ostringstream os;
-    os << "RuntimeError: " << err;
-    throw new TeetonError(os.str());
-}
-
 void parseError(string err, int lineIndex, int colIndex) {
     ostringstream os;
     os << "Parse error: " << err << " [line: " << lineIndex << ", col: " << colIndex << "] ";
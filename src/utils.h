@@ -6,8 +6,6 @@
 #include <vector>
 #include <exception>
 
-void runtimeError(std::string err);
-
 void parseError(std::string err, int lineIndex, int colIndex);
 
 bool contains(const std::string &str, char c);
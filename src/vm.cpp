@@ -0,0 +1,300 @@
+#include "vm.h"
+#include "node.h"
+
+using namespace std;
+
+Vm::Vm(Chunk *chunk, Environment *env) : chunk(chunk), env(env), registers(chunk->registerCount) {
+    copy(chunk->constants.begin(), chunk->constants.end(), registers.begin());
+    for (size_t i = chunk->constants.size(); i < registers.size(); i++) {
+        env->roots.push_back(&registers[i]);
+    }
+}
+
+Vm::~Vm() {
+    env->roots.resize(env->roots.size() - (registers.size() - chunk->constants.size()));
+}
+
+// -----------------------------------------------------------------------------
+
+// With GCC every instruction jumps straight to the next one through a table of labels,
+// other compilers go through a switch.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define TARGET(opcode) L_##opcode:
+#define DISPATCH() goto *targets[ip->opcode]
+#else
+#define TARGET(opcode) case opcode:
+#define DISPATCH() goto dispatch
+#endif
+
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define SITE() chunk->sites[ip - code]
+
+// Instructions which can fail or break return as soon as the completion is not normal. Every new int, bool
+// or char can fail once the identities run out.
+#define CHECK() do { if (env->abrupt()) return Value(); } while (0)
+
+#define SCALAR_OPERATOR(opcode, op, operandType, accessor, result) \
+    TARGET(opcode) { \
+        Value &t1 = r[ip->b]; \
+        Value t2 = r[ip->c]; \
+        if (t1.type() == operandType && t2.type() == operandType) { \
+            auto a = t1.accessor(); \
+            auto b = t2.accessor(); \
+            r[ip->a] = result; \
+        } else { \
+            r[ip->a] = NodeBinaryOperator::apply(env, op, t1, t2, SITE()); \
+        } \
+        CHECK(); \
+        NEXT(); \
+    }
+
+// The comparison is not stored, the jump after the test is taken when it is false.
+#define TEST_OPERATOR(opcode, op, comparison) \
+    TARGET(opcode) { \
+        Value &t1 = r[ip->b]; \
+        Value t2 = r[ip->c]; \
+        bool result; \
+        if (t1.type() == INT && t2.type() == INT) { \
+            int a = t1.intValue(); \
+            int b = t2.intValue(); \
+            result = comparison; \
+        } else { \
+            result = NodeBinaryOperator::apply(env, op, t1, t2, SITE()).boolValue(); \
+            CHECK(); \
+        } \
+        ip = result ? ip + 2 : code + ip[1].target(); \
+        DISPATCH(); \
+    }
+
+Value Vm::run() {
+    Value *r = registers.data();
+    const Instruction *code = chunk->code.data();
+    const Instruction *ip = code;
+
+#if defined(__GNUC__)
+    static void *targets[OPCODE_COUNT] = {
+            &&L_OP_MOVE, &&L_OP_LOAD_VARIABLE, &&L_OP_STORE_VARIABLE,
+            &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV, &&L_OP_MOD, &&L_OP_EQ, &&L_OP_NEQ, &&L_OP_EQEQ,
+            &&L_OP_GT, &&L_OP_LT, &&L_OP_GTE, &&L_OP_LTE, &&L_OP_AND, &&L_OP_OR,
+            &&L_OP_NOT, &&L_OP_LEN, &&L_OP_APPEND, &&L_OP_GET, &&L_OP_SET,
+            &&L_OP_PRINT, &&L_OP_PRINTLN, &&L_OP_SCAN_INT, &&L_OP_SCAN_CHAR, &&L_OP_SCAN_STRING,
+            &&L_OP_JUMP, &&L_OP_JUMP_IF_FALSE, &&L_OP_TEST_EQ, &&L_OP_TEST_NEQ, &&L_OP_TEST_GT, &&L_OP_TEST_LT,
+            &&L_OP_TEST_GTE, &&L_OP_TEST_LTE, &&L_OP_SAFEPOINT, &&L_OP_EVALUATE, &&L_OP_RETURN
+    };
+    DISPATCH();
+#else
+    dispatch:
+    switch (ip->opcode) {
+#endif
+
+    TARGET(OP_MOVE) {
+        r[ip->a] = r[ip->b];
+        NEXT();
+    }
+
+    TARGET(OP_LOAD_VARIABLE) {
+        r[ip->a] = env->getVariable(ip->b);
+        // an undefined variable loads null
+        if (r[ip->a].isNull()) {
+            CHECK();
+        }
+        NEXT();
+    }
+
+    TARGET(OP_STORE_VARIABLE) {
+        env->site = SITE();
+        env->setVariable(ip->a, r[ip->b]);
+        // only lists are materialized, which can run out of memory
+        if (r[ip->b].isList()) {
+            CHECK();
+        }
+        NEXT();
+    }
+
+    SCALAR_OPERATOR(OP_ADD, ADD, INT, intValue, env->makeInt(a + b))
+    SCALAR_OPERATOR(OP_SUB, SUB, INT, intValue, env->makeInt(a - b))
+    SCALAR_OPERATOR(OP_MUL, MUL, INT, intValue, env->makeInt(a * b))
+    SCALAR_OPERATOR(OP_DIV, DIV, INT, intValue, env->makeInt(a / b))
+    SCALAR_OPERATOR(OP_MOD, MOD, INT, intValue, env->makeInt(a % b))
+    SCALAR_OPERATOR(OP_EQ, EQ, INT, intValue, env->makeBool(a == b))
+    SCALAR_OPERATOR(OP_NEQ, NEQ, INT, intValue, env->makeBool(a != b))
+    SCALAR_OPERATOR(OP_GT, GT, INT, intValue, env->makeBool(a > b))
+    SCALAR_OPERATOR(OP_LT, LT, INT, intValue, env->makeBool(a < b))
+    SCALAR_OPERATOR(OP_GTE, GTE, INT, intValue, env->makeBool(a >= b))
+    SCALAR_OPERATOR(OP_LTE, LTE, INT, intValue, env->makeBool(a <= b))
+    SCALAR_OPERATOR(OP_AND, AND, BOOL, boolValue, env->makeBool(a && b))
+    SCALAR_OPERATOR(OP_OR, OR, BOOL, boolValue, env->makeBool(a || b))
+
+    TARGET(OP_EQEQ) {
+        r[ip->a] = NodeBinaryOperator::apply(env, EQEQ, r[ip->b], r[ip->c], SITE());
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_NOT) {
+        Value t = r[ip->b];
+        if (t.type() != BOOL) {
+            return env->fail("Using not operator with non-boolean variable.");
+        }
+        r[ip->a] = env->makeBool(!t.boolValue());
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_LEN) {
+        Value result = r[ip->b];
+        if (result.type() != LIST) {
+            return env->fail("len can be only used with lists.");
+        }
+        r[ip->a] = env->makeInt((int) result.listValue()->size());
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_APPEND) {
+        Value &listResult = r[ip->a];
+        Value &valueResult = r[ip->b];
+        if (listResult.type() != LIST) {
+            return env->fail("First argument of append must be list.");
+        }
+
+        env->site = SITE();
+        listResult = env->materialize(listResult);
+        valueResult = env->materialize(valueResult);
+        CHECK();
+
+        TypeList *list = listResult.listValue();
+        list->append(valueResult);
+        env->writeBarrier(list, list->size() - 1, valueResult);
+        NEXT();
+    }
+
+    TARGET(OP_GET) {
+        Value listResult = r[ip->b];
+        Value indexResult = r[ip->c];
+        if (listResult.type() != LIST) {
+            return env->fail("First argument of append must be list.");
+        }
+        if (indexResult.type() != INT) {
+            return env->fail("Second argument of get must be int.");
+        }
+
+        // the register is a root, it is shaded like the value of a Root
+        Value result = listResult.listValue()->get((unsigned) indexResult.intValue());
+        if (env->marking) {
+            env->shade(result);
+        }
+        r[ip->a] = result;
+        NEXT();
+    }
+
+    TARGET(OP_SET) {
+        Value &listResult = r[ip->a];
+        Value indexResult = r[ip->b];
+        Value &valueResult = r[ip->c];
+        if (listResult.type() != LIST) {
+            return env->fail("First argument of set must be list.");
+        }
+        if (indexResult.type() != INT) {
+            return env->fail("Second argument of set must be int.");
+        }
+
+        env->site = SITE();
+        listResult = env->materialize(listResult);
+        valueResult = env->materialize(valueResult);
+        CHECK();
+
+        TypeList *list = listResult.listValue();
+        list->set((unsigned) indexResult.intValue(), valueResult);
+        env->writeBarrier(list, (unsigned) indexResult.intValue(), valueResult);
+        NEXT();
+    }
+
+    TARGET(OP_PRINT) {
+        cout << r[ip->a].toString();
+        NEXT();
+    }
+
+    TARGET(OP_PRINTLN) {
+        cout << r[ip->a].toString() << endl;
+        NEXT();
+    }
+
+    TARGET(OP_SCAN_INT) {
+        int number;
+        cin >> number;
+        r[ip->a] = env->makeInt(number);
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_SCAN_CHAR) {
+        char character;
+        cin >> character;
+        r[ip->a] = env->makeChar(character);
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_SCAN_STRING) {
+        string input;
+        cin >> input;
+        env->site = SITE();
+        r[ip->a] = Value::fromList(env->allocList(env->makeString(input)));
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_JUMP) {
+        ip = code + ip->target();
+        DISPATCH();
+    }
+
+    TARGET(OP_JUMP_IF_FALSE) {
+        Value evaluated = r[ip->a];
+        if (evaluated.type() != BOOL) {
+            return env->fail("Cannot use non-bool value for condition.");
+        }
+        if (!evaluated.boolValue()) {
+            ip = code + ip->target();
+            DISPATCH();
+        }
+        NEXT();
+    }
+
+    TEST_OPERATOR(OP_TEST_EQ, EQ, a == b)
+    TEST_OPERATOR(OP_TEST_NEQ, NEQ, a != b)
+    TEST_OPERATOR(OP_TEST_GT, GT, a > b)
+    TEST_OPERATOR(OP_TEST_LT, LT, a < b)
+    TEST_OPERATOR(OP_TEST_GTE, GTE, a >= b)
+    TEST_OPERATOR(OP_TEST_LTE, LTE, a <= b)
+
+    TARGET(OP_SAFEPOINT) {
+        if (!env->safepoint()) {
+            return Value();
+        }
+        NEXT();
+    }
+
+    TARGET(OP_EVALUATE) {
+        r[ip->a] = chunk->nodes[ip->b]->evaluate(env);
+        CHECK();
+        NEXT();
+    }
+
+    TARGET(OP_RETURN) {
+        return r[ip->a];
+    }
+
+#if !defined(__GNUC__)
+        default:
+            return Value();
+    }
+#endif
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,28 @@
+#ifndef TEETON_VM_H
+#define TEETON_VM_H
+
+#include <vector>
+
+#include "compiler.h"
+#include "environment.h"
+
+// Executes a compiled chunk. The temporaries of the chunk are roots of the collector while it runs.
+class Vm {
+public:
+    Vm(Chunk *chunk, Environment *env);
+
+    ~Vm();
+
+    Value run();
+
+private:
+    Vm(const Vm &) = delete;
+
+    Vm &operator=(const Vm &) = delete;
+
+    Chunk *chunk;
+    Environment *env;
+    std::vector<Value> registers;
+};
+
+#endif //TEETON_VM_H
@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+
+SUCCESS="\033[0;32m✓\033[0m"
+FAIL="\033[0;31mfailed\033[0m"
+
+# every test is translated with teeton --emit-c and built with the system compiler, CC=clang ./c-runner.sh
+CC=${CC:-cc}
+BUILD=$(mktemp -d)
+trap "rm -rf $BUILD" EXIT
+
+echo "Running Teeton tests compiled to C"
+
+for f in $(ls ttn); do
+    file=${f%%.*}
+    echo -n $file"... "
+
+    if ! ../build/teeton --emit-c ttn/$file.ttn > $BUILD/$file.c ||
+       ! $CC -O2 -I../runtime -o $BUILD/$file $BUILD/$file.c ../runtime/teeton.c; then
+        echo -e $FAIL
+        continue
+    fi
+
+    if [ ! -f in/$file.in ]; then
+        $BUILD/$file | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
+    else
+        $BUILD/$file < in/$file.in | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
+    fi
+done
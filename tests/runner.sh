@@ -3,15 +3,56 @@
 SUCCESS="\033[0;32m✓\033[0m"
 FAIL="\033[0;31mfailed\033[0m"
 
-echo "Running Teeton tests"
+# arguments are passed to teeton, e.g. ./runner.sh --engine=vm
+echo "Running Teeton tests $@"
 
 for f in $(ls ttn); do
     file=${f%%.*}
     echo -n $file"... "
 
     if [ ! -f in/$file.in ]; then
-        ../build/teeton ttn/$file.ttn | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
+        ../build/teeton "$@" ttn/$file.ttn | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
     else
-        ../build/teeton ttn/$file.ttn < in/$file.in  | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
+        ../build/teeton "$@" ttn/$file.ttn < in/$file.in  | diff out/$file.out - > /dev/null && echo -e $SUCCESS || echo -e $FAIL
     fi
 done
+
+# statistics of the collector, the json on stderr has to parse and list a cycle, the environment and the text
+# report have to give the same number of cycles
+echo -n "gc-stats... "
+cycles() {
+    python3 -c 'import json, sys; cycles = json.load(sys.stdin)["cycles"]; print(len(cycles) if cycles else "none")'
+}
+option=$(../build/teeton "$@" --heap-initial=64K --gc-stats=json ttn/large-heap.ttn 2>&1 > /dev/null | cycles)
+environment=$(TEETON_GC_STATS=json ../build/teeton "$@" --heap-initial=64K ttn/large-heap.ttn 2>&1 > /dev/null | cycles)
+text=$(../build/teeton "$@" --heap-initial=64K --gc-stats ttn/large-heap.ttn 2>&1 > /dev/null | head -1)
+[[ $option =~ ^[0-9]+$ && $option == $environment && $text == "gc: $option cycles,"* ]] && echo -e $SUCCESS || echo -e $FAIL
+
+# a program going over --heap-max still prints its statistics after the error
+echo -n "gc-stats-out-of-memory... "
+error=$(../build/teeton "$@" --heap-initial=16K --heap-max=64K --gc-stats=json ttn/large-heap.ttn 2> /dev/null)
+oom=$(../build/teeton "$@" --heap-initial=16K --heap-max=64K --gc-stats=json ttn/large-heap.ttn 2>&1 > /dev/null | cycles)
+[[ $error == "RuntimeError: Out of memory" && $oom =~ ^[0-9]+$ ]] && echo -e $SUCCESS || echo -e $FAIL
+
+# heap snapshot, the summary has to group the bytes of the lists in the snapshot under their allocation site,
+# the 5000 cells of large-heap.ttn are allocated at 4:5
+echo -n "heap-snapshot... "
+SNAPSHOT=$(mktemp)
+../build/teeton "$@" --heap-snapshot=$SNAPSHOT ttn/large-heap.ttn > /dev/null
+site=$(awk '$1 == "site" && $3 == 4 && $4 == 5 { print $2 }' $SNAPSHOT)
+live=$(awk -v site=$site '$1 == "list" && $6 == site { lists++; bytes += $5 } END { print bytes, lists }' $SNAPSHOT)
+summary=$(../build/teeton --heap-summary=$SNAPSHOT | awk '$3 == "4:5" { print $1, $2 }')
+# a program going over --heap-max still writes the snapshot, with the cells allocated until then
+error=$(../build/teeton "$@" --heap-initial=16K --heap-max=64K --heap-snapshot=$SNAPSHOT ttn/large-heap.ttn)
+oom=$(../build/teeton --heap-summary=$SNAPSHOT | awk '$3 == "4:5" { print $2 }')
+rm -f $SNAPSHOT
+[[ -n $site && $summary == "$live" && $live == *" 5000" && $error == "RuntimeError: Out of memory" && $oom -gt 0 ]] \
+&& echo -e $SUCCESS || echo -e $FAIL
+
+# identities of values are never reused, a program making more than 2^28 of them fails, the jit gets there fast
+echo -n "out-of-identities... "
+PROGRAM=$(mktemp)
+printf 'i = 0\nwhile (i < 300000000) {\n    i = i + 1\n}\nprintln(i)\n' > $PROGRAM
+error=$(../build/teeton --jit $PROGRAM)
+rm -f $PROGRAM
+[[ $error == "RuntimeError: Out of identities" ]] && echo -e $SUCCESS || echo -e $FAIL